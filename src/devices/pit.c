@@ -15,9 +15,6 @@
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /*!< Counter port. */
 /*! @} */
 
-/*! PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /*! Configure the given CHANNEL in the PIT.  In a PC, the PIT's
     three output channels are hooked up like this:
 
@@ -79,3 +76,38 @@ void pit_configure_channel(int channel, int mode, int frequency) {
     intr_set_level(old_level);
 }
 
+
+/*! Starts channel 0 on a single countdown of COUNT PIT cycles in mode 0,
+    "interrupt on terminal count": the output goes high, raising one timer
+    interrupt, when the count reaches zero, and stays high until the channel
+    is reprogrammed.  COUNT must be nonzero. */
+void pit_start_oneshot(uint16_t count) {
+    enum intr_level old_level;
+
+    ASSERT(count != 0);
+
+    old_level = intr_disable();
+    outb(PIT_PORT_CONTROL, 0x30);
+    outb(PIT_PORT_COUNTER(0), count);
+    outb(PIT_PORT_COUNTER(0), count >> 8);
+    intr_set_level(old_level);
+}
+
+/*! Returns the current count of CHANNEL and stores the level of its output
+    pin in *OUTPUT, using the 8254's read-back command. */
+uint16_t pit_read_channel(int channel, bool *output) {
+    enum intr_level old_level;
+    uint8_t status, lo, hi;
+
+    ASSERT(channel == 0 || channel == 2);
+
+    old_level = intr_disable();
+    outb(PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+    status = inb(PIT_PORT_COUNTER(channel));
+    lo = inb(PIT_PORT_COUNTER(channel));
+    hi = inb(PIT_PORT_COUNTER(channel));
+    intr_set_level(old_level);
+
+    *output = (status & 0x80) != 0;
+    return lo | (hi << 8);
+}
@@ -5,6 +5,12 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -13,6 +19,9 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /*! Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -82,6 +91,7 @@ void shutdown_power_off(void) {
     filesys_done();
 #endif
 
+    trace_dump();
     print_stats();
 
     printf("Powering off...\n");
@@ -112,6 +122,11 @@ void shutdown_power_off(void) {
 static void print_stats(void) {
     timer_print_stats();
     thread_print_stats();
+    lock_print_stats();
+    profile_print_stats();
+    palloc_print_stats();
+    kmem_cache_print_stats();
+    malloc_print_stats();
 #ifdef FILESYS
     block_print_stats();
 #endif
@@ -120,5 +135,8 @@ static void print_stats(void) {
 #ifdef USERPROG
     exception_print_stats();
 #endif
+#ifdef VM
+    vm_print_stats();
+#endif
 }
 
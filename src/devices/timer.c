@@ -6,11 +6,13 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <rdtsc.h>
 #include <round.h>
 #include <stdio.h>
 #include <list.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -24,9 +26,40 @@
 /*! Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/*! If true, stop the periodic tick while the idle thread runs.
+    Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Dynamic ticks.  When the idle thread is about to halt, the PIT is
+   switched to a single countdown that ends on the tick of the next due
+   alarm (or the next wheel cascade), as far ahead as its 16-bit counter
+   reaches.  The ticks slept through are then processed in one go by
+   timer_interrupt(). */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define IDLE_MAX_TICKS (UINT16_MAX / TICK_CYCLES)
+
+static int oneshot_ticks;       /* Ticks the pending countdown ends, or 0. */
+static uint16_t oneshot_cycles; /* Length of that countdown. */
+static uint16_t oneshot_first;  /* Cycles to its first tick boundary. */
+static int64_t lost_ticks;      /* Ticks passed but not processed yet. */
+static int64_t skipped_ticks;   /* Ticks that needed no interrupt. */
+
 /*! Number of loops per timer tick.  Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* TSC clocksource, calibrated against the PIT by timer_calibrate().
+   A TSC reading converts to nanoseconds since boot as
+   (tsc - tsc_base) * tsc_mult >> tsc_shift.  The shift is TSC_SHIFT_MAX
+   unless the TSC is so slow that the scale would not fit in 32 bits, as
+   under Bochs with ips=1000000. */
+#define TSC_SHIFT_MAX 24
+#define TSC_CALIBRATE_TICKS (TIMER_FREQ / 10)
+
+static uint64_t tsc_base;       /*!< TSC reading at timer tick 0. */
+static uint32_t tsc_mult;       /*!< Nanoseconds per cycle << tsc_shift. */
+static unsigned tsc_shift;      /*!< Fraction bits in tsc_mult. */
+static uint64_t tsc_hz;         /*!< TSC cycles per second. */
+
 static intr_handler_func timer_interrupt;
 
 // alarm clock with the semaphore that makes a thread sleep
@@ -36,41 +69,127 @@ struct alarm {
     struct list_elem elem;
 };
 
-// the list of alarm to be checked for expiration
-static struct list alarm_list;
+/* Pending alarms are kept in a hierarchical timing wheel.  Level 0 has
+   one slot per tick for the next WHEEL0_SIZE ticks; each slot of level
+   L > 0 spans a whole turn of level L - 1.  Inserting an alarm is O(1),
+   and when a lower level wraps around, the next slot of the level above
+   is cascaded down into it.  Alarms beyond the top level's range wait in
+   its farthest slot and are re-filed each time they are cascaded. */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL_LEVELS 4
 
-// the next alarm to be put into alarm_list by timer_interrupt()
-static struct list_elem *alarm_to_sleep;
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEEL_LEVELS - 1][WHEELN_SIZE];
 
-// writing and reading semaphores for alarm_to_sleep
-static struct semaphore alarm_sema_w;
-static struct semaphore alarm_sema_r;
+// the next tick whose level 0 slot has not been expired yet
+static int64_t wheel_ticks;
 
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
+static void tsc_calibrate(void);
 
 static void alarm_init(void);
-static bool alarm_less_eq(
-        const struct list_elem *a_, 
-        const struct list_elem *b_,
-        void *aux UNUSED);
+static void alarm_add(struct alarm *);
+static void alarm_cascade(int level);
+static void alarm_expire(void);
+static int alarm_next_due(int max);
 
 static void alarm_init(void) {
-    list_init(&alarm_list);
-    alarm_to_sleep = list_tail(&alarm_list);
-    sema_init(&alarm_sema_w, 1);
-    sema_init(&alarm_sema_r, 0);
+    int i, l;
+
+    for (i = 0; i < WHEEL0_SIZE; i++)
+        list_init(&wheel0[i]);
+    for (l = 0; l < WHEEL_LEVELS - 1; l++)
+        for (i = 0; i < WHEELN_SIZE; i++)
+            list_init(&wheeln[l][i]);
+    wheel_ticks = 0;
+}
+
+/* Returns the bit position of the slot index of LEVEL in a tick count. */
+static inline int wheel_shift(int level) {
+    return WHEEL0_BITS + (level - 1) * WHEELN_BITS;
+}
+
+/* Files A into the wheel slot for its expiration time.  Must be called
+   with interrupts off. */
+static void alarm_add(struct alarm *a) {
+    int64_t expires = a->expires_at;
+    int64_t delta = expires - wheel_ticks;
+    struct list *slot;
+    int l;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (delta < WHEEL0_SIZE) {
+        /* Already due alarms go in the next slot to be expired. */
+        if (delta < 0)
+            expires = wheel_ticks;
+        slot = &wheel0[expires & (WHEEL0_SIZE - 1)];
+    } else {
+        for (l = 1; l < WHEEL_LEVELS - 1; l++)
+            if (delta < (int64_t) 1 << wheel_shift(l + 1))
+                break;
+        if (delta >= (int64_t) 1 << wheel_shift(l + 1))
+            expires = wheel_ticks + ((int64_t) 1 << wheel_shift(l + 1)) - 1;
+        slot = &wheeln[l - 1][(expires >> wheel_shift(l)) & (WHEELN_SIZE - 1)];
+    }
+
+    list_push_back(slot, &a->elem);
+}
+
+/* Moves the alarms in the current slot of LEVEL down to lower levels. */
+static void alarm_cascade(int level) {
+    int idx = (wheel_ticks >> wheel_shift(level)) & (WHEELN_SIZE - 1);
+    struct list *slot = &wheeln[level - 1][idx];
+    struct list pending;
+
+    if (idx == 0 && level < WHEEL_LEVELS - 1)
+        alarm_cascade(level + 1);
+
+    /* Detach the slot first: alarms beyond the top level come back to it. */
+    list_init(&pending);
+    while (!list_empty(slot))
+        list_push_back(&pending, list_pop_front(slot));
+    while (!list_empty(&pending))
+        alarm_add(list_entry(list_pop_front(&pending), struct alarm, elem));
 }
 
-static bool alarm_less_eq(
-        const struct list_elem *a_, 
-        const struct list_elem *b_,
-        void *aux UNUSED) {
-    const struct alarm *a = list_entry(a_, struct alarm, elem);
-    const struct alarm *b = list_entry(b_, struct alarm, elem);
-    return a->expires_at <= b->expires_at;
+/* Wakes up every alarm due by the current tick. */
+static void alarm_expire(void) {
+    struct list *slot;
+    int idx;
+
+    while (wheel_ticks <= ticks) {
+        idx = wheel_ticks & (WHEEL0_SIZE - 1);
+        if (idx == 0)
+            alarm_cascade(1);
+
+        slot = &wheel0[idx];
+        while (!list_empty(slot))
+            sema_up(&list_entry(list_pop_front(slot), struct alarm,
+                                elem)->expired);
+        wheel_ticks++;
+    }
+}
+
+/* Returns the number of ticks until the next one that has alarms due or
+   cascades the wheel, or MAX if that is farther. */
+static int alarm_next_due(int max) {
+    int64_t t;
+    int n;
+
+    for (n = 1; n < max; n++) {
+        t = wheel_ticks + n - 1;
+        if ((t & (WHEEL0_SIZE - 1)) == 0
+            || !list_empty(&wheel0[t & (WHEEL0_SIZE - 1)]))
+            break;
+    }
+    return n;
 }
 
 /*! Sets up the timer to interrupt TIMER_FREQ times per second,
@@ -104,12 +223,68 @@ void timer_calibrate(void) {
     }
 
     printf("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+    tsc_calibrate();
+}
+
+/*! Measures the TSC rate over TSC_CALIBRATE_TICKS timer ticks and sets
+    the TSC reading that corresponds to tick 0. */
+static void tsc_calibrate(void) {
+    int64_t start;
+    uint64_t t0, t1, mult;
+
+    /* Wait for a timer tick. */
+    start = timer_ticks();
+    while (timer_ticks() == start)
+        barrier();
+
+    start = timer_ticks();
+    t0 = rdtsc();
+    while (timer_ticks() < start + TSC_CALIBRATE_TICKS)
+        barrier();
+    t1 = rdtsc();
+
+    tsc_hz = (t1 - t0) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+    ASSERT(tsc_hz > 0);
+
+    /* Keep as many fraction bits as the 32-bit scale allows. */
+    tsc_shift = TSC_SHIFT_MAX;
+    while (tsc_shift > 0
+           && ((uint64_t) 1000000000 << tsc_shift) / tsc_hz > UINT32_MAX)
+        tsc_shift--;
+    mult = ((uint64_t) 1000000000 << tsc_shift) / tsc_hz;
+    ASSERT(mult > 0 && mult <= UINT32_MAX);
+    tsc_mult = mult;
+    tsc_base = t0 - (t1 - t0) * start / TSC_CALIBRATE_TICKS;
+}
+
+/*! Returns the number of nanoseconds since the OS booted, read from the
+    TSC, or 0 before timer_calibrate() has run. */
+uint64_t timer_now_ns(void) {
+    uint64_t cycles;
+    uint32_t lo, hi;
+
+    if (tsc_mult == 0)
+        return 0;
+
+    /* 64 x 32-bit multiply in two halves, to avoid overflow. */
+    cycles = rdtsc() - tsc_base;
+    lo = cycles;
+    hi = cycles >> 32;
+    return (((uint64_t) lo * tsc_mult) >> tsc_shift)
+           + (((uint64_t) hi * tsc_mult) << (32 - tsc_shift));
+}
+
+/*! Returns the TSC frequency in Hz, or 0 before timer_calibrate() has
+    run. */
+uint64_t timer_tsc_hz(void) {
+    return tsc_hz;
 }
 
 /*! Returns the number of timer ticks since the OS booted. */
 int64_t timer_ticks(void) {
     enum intr_level old_level = intr_disable();
-    int64_t t = ticks;
+    int64_t t = ticks + lost_ticks;
     intr_set_level(old_level);
     return t;
 }
@@ -124,16 +299,19 @@ int64_t timer_elapsed(int64_t then) {
     be turned on. */
 void timer_sleep(int64_t ticks) {
     struct alarm a;
-    a.expires_at = timer_ticks() + ticks;
+    enum intr_level old_level;
+
+    ASSERT(intr_get_level() == INTR_ON);
+    if (ticks <= 0)
+        return;
+
     sema_init(&a.expired, 0);
 
-    // only one alarm can be passed each tick
-    // other threads need to wait until timer_interrupt() takes it away
-    sema_down(&alarm_sema_w);
-    alarm_to_sleep = &a.elem;
-    sema_up(&alarm_sema_r);
+    old_level = intr_disable();
+    a.expires_at = timer_ticks() + ticks;
+    alarm_add(&a);
+    intr_set_level(old_level);
 
-    ASSERT(intr_get_level() == INTR_ON);
     sema_down(&a.expired);
 }
 
@@ -181,42 +359,97 @@ void timer_ndelay(int64_t ns) {
     real_time_delay(ns, 1000 * 1000 * 1000);
 }
 
+/*! Stops the periodic tick until the next tick that has work to do.
+    Called by the idle thread, with interrupts off, right before it halts. */
+void timer_idle_enter(void) {
+    bool output;
+    int n;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (!timer_tickless || oneshot_ticks > 0 || lost_ticks > 0)
+        return;
+
+    n = alarm_next_due(IDLE_MAX_TICKS);
+    if (n < 2)
+        return;
+
+    /* Keep the phase of the periodic tick: the countdown ends exactly
+       where the N-th periodic interrupt would have come. */
+    oneshot_first = pit_read_channel(0, &output);
+    if (oneshot_first == 0 || oneshot_first > TICK_CYCLES)
+        oneshot_first = TICK_CYCLES;
+    oneshot_cycles = oneshot_first + (n - 1) * TICK_CYCLES;
+    oneshot_ticks = n;
+    pit_start_oneshot(oneshot_cycles);
+}
+
+/*! Accounts for the ticks that passed while the idle thread was halted
+    and woken by some other interrupt.  Called by the idle thread, with
+    interrupts off, before it blocks again. */
+void timer_idle_exit(void) {
+    uint16_t count, elapsed, next;
+    bool output;
+    int passed;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (oneshot_ticks == 0)
+        return;
+
+    /* If the countdown already ended, its interrupt is pending and
+       timer_interrupt() will do the accounting. */
+    count = pit_read_channel(0, &output);
+    if (output)
+        return;
+
+    /* Count the tick boundaries already passed, and end a new countdown
+       on the next one, which restores the periodic tick. */
+    elapsed = oneshot_cycles - count;
+    passed = elapsed < oneshot_first
+             ? 0 : (elapsed - oneshot_first) / TICK_CYCLES + 1;
+    next = oneshot_first + passed * TICK_CYCLES - elapsed;
+
+    lost_ticks += passed;
+    skipped_ticks += passed;
+    oneshot_ticks = 1;
+    oneshot_cycles = oneshot_first = next;
+    pit_start_oneshot(next);
+}
+
 /*! Prints timer statistics. */
 void timer_print_stats(void) {
     printf("Timer: %"PRId64" ticks\n", timer_ticks());
+    if (timer_tickless)
+        printf("Timer: %"PRId64" ticks skipped while idle\n", skipped_ticks);
 }
 
 /*! Timer interrupt handler. */
-static void timer_interrupt(struct intr_frame *args UNUSED) {
-    struct alarm *a;
-    struct list_elem *e;
-    ticks++;
-
-    // put alarm in the list in ascending order of expiration
-    if (sema_try_down(&alarm_sema_r)) {
-        list_insert_ordered(&alarm_list, alarm_to_sleep, alarm_less_eq, 0);
-        sema_up(&alarm_sema_w);
+static void timer_interrupt(struct intr_frame *args) {
+    int64_t n = 1;
+
+    if (profile_enabled)
+        profile_sample(args);
+
+    /* The end of a countdown set up by timer_idle_enter() or
+       timer_idle_exit().  Go back to the periodic tick. */
+    if (oneshot_ticks > 0) {
+        n = oneshot_ticks;
+        skipped_ticks += n - 1;
+        oneshot_ticks = 0;
+        pit_configure_channel(0, 2, TIMER_FREQ);
     }
+    n += lost_ticks;
+    lost_ticks = 0;
 
-    // check alarms and wake up processes
-    if (!list_empty(&alarm_list)) {
-        for (e = list_front(&alarm_list);
-             e != list_tail(&alarm_list);
-             e = list_next(e)) {
+    while (n-- > 0) {
+        ticks++;
 
-            a = list_entry(e, struct alarm, elem);
+        // wake up processes whose alarms are due
+        alarm_expire();
 
-            if (ticks >= a->expires_at) {
-                sema_up(&a->expired);
-                list_remove(e);
-            } else {
-                // I can do so because alarms are sorted
-                break;
-            }
-        }
+        thread_tick();
     }
-
-    thread_tick();
 }
 
 /*! Returns true if LOOPS iterations waits for more than one timer tick,
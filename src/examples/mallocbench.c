@@ -0,0 +1,59 @@
+/* mallocbench.c
+
+   Measures the user-level malloc() and free() with the monotonic
+   clock.
+
+   Reports the time of a malloc() and free() pair of one small size,
+   which should always reuse the same block, and of a mixed workload
+   that keeps a few hundred blocks of random sizes live, so that the
+   heap grows with sbrk() and large blocks are split and reused. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define PAIR_ITERS 100000
+#define MIXED_ITERS 100000
+#define LIVE_MAX 512
+
+static void *live[LIVE_MAX];
+
+int
+main (void)
+{
+  uint64_t start, end;
+  char *heap;
+  int i;
+
+  heap = sbrk (0);
+  start = clock_ns ();
+  for (i = 0; i < PAIR_ITERS; i++)
+    free (malloc (32));
+  end = clock_ns ();
+  printf ("malloc + free, 32 bytes: %llu ns\n",
+          (end - start) / PAIR_ITERS);
+
+  random_init (0);
+  start = clock_ns ();
+  for (i = 0; i < MIXED_ITERS; i++)
+    {
+      int j = random_ulong () % LIVE_MAX;
+      size_t size = random_ulong () % 16 == 0
+                    ? 4096 + random_ulong () % (28 * 1024)
+                    : 1 + random_ulong () % 1024;
+
+      free (live[j]);
+      live[j] = malloc (size);
+      if (live[j] == NULL)
+        {
+          printf ("malloc: out of memory\n");
+          return EXIT_FAILURE;
+        }
+    }
+  end = clock_ns ();
+  printf ("mixed malloc + free: %llu ns\n", (end - start) / MIXED_ITERS);
+  printf ("heap: %d kB\n", (int) ((char *) sbrk (0) - heap) / 1024);
+
+  return EXIT_SUCCESS;
+}
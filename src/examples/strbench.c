@@ -0,0 +1,14 @@
+/* strbench.c
+
+   Checks and times memcpy(), memmove(), memset() and memcmp() from
+   libc.a, with the program in tests/internal/string.c. */
+
+#include <syscall.h>
+#include "tests/internal/string.c"
+
+int
+main (void)
+{
+  test ();
+  return EXIT_SUCCESS;
+}
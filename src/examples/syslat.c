@@ -0,0 +1,46 @@
+/* syslat.c
+
+   Measures system call latencies with the monotonic clock.
+
+   Reports the average round trip of clock_ns() itself, which is about
+   the cheapest system call there is, and the time to fork a child and
+   wait for it to exit. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+#define CLOCK_ITERS 10000
+#define FORK_ITERS 20
+
+int
+main (void)
+{
+  uint64_t start, end;
+  int i;
+
+  start = clock_ns ();
+  for (i = 0; i < CLOCK_ITERS; i++)
+    clock_ns ();
+  end = clock_ns ();
+  printf ("clock_ns: %llu ns per call\n",
+          (end - start) / (CLOCK_ITERS + 1));
+
+  start = clock_ns ();
+  for (i = 0; i < FORK_ITERS; i++)
+    {
+      pid_t pid = fork ();
+      if (pid == 0)
+        exit (0);
+      if (pid == PID_ERROR)
+        {
+          printf ("fork: not supported\n");
+          return EXIT_SUCCESS;
+        }
+      wait (pid);
+    }
+  end = clock_ns ();
+  printf ("fork + exit + wait: %llu us\n",
+          (end - start) / FORK_ITERS / 1000);
+
+  return EXIT_SUCCESS;
+}
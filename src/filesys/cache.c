@@ -13,6 +13,7 @@
 #include "threads/thread.h"
 #include "threads/malloc.h"
 #include "threads/interrupt.h"
+#include "threads/trace.h"
 #include "filesys/filesys.h"
 #include "devices/timer.h"
 
@@ -260,9 +261,11 @@ static int32_t get_cache(block_sector_t idx, struct cache_entry **ce) {
 
   if (e != NULL) {
     /* Data already in cache */
+    TRACE(TRACE_CACHE_HIT, idx);
     *ce = hash_entry(e, struct cache_entry, elem);
     old_sector = (*ce)->sector;
   } else {
+    TRACE(TRACE_CACHE_MISS, idx);
  
     if (empty_list != -1) {
       /* From empty list */
@@ -274,6 +277,7 @@ static int32_t get_cache(block_sector_t idx, struct cache_entry **ce) {
       *ce = &cache_header[evict()];
       hash_delete(&cache_table, &(*ce)->elem);
       old_sector = (*ce)->sector;
+      TRACE(TRACE_CACHE_EVICT, old_sector);
     }
 
     (*ce)->sector = idx;
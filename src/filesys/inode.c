@@ -7,6 +7,7 @@
 #include "filesys/free-map.h"
 #include "filesys/cache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 /*! Identifies an inode. */
@@ -70,9 +71,15 @@ static block_sector_t byte_to_sector(const struct inode *inode, off_t pos) {
     returns the same `struct inode'. */
 static struct list open_inodes;
 
+/*! Cache of in-memory inodes.  A struct inode is a little over
+    half a kilobyte, which malloc() would round up to a whole 1 kB
+    block. */
+static struct kmem_cache *inode_cache;
+
 /*! Initializes the inode module. */
 void inode_init(void) {
     list_init(&open_inodes);
+    inode_cache = kmem_cache_create("inode", sizeof(struct inode), NULL);
 }
 
 /*! Initializes an inode with LENGTH bytes of data and
@@ -165,7 +172,7 @@ struct inode * inode_open(block_sector_t sector) {
     }
 
     /* Allocate memory. */
-    inode = malloc(sizeof *inode);
+    inode = kmem_cache_alloc(inode_cache);
     if (inode == NULL)
         return NULL;
 
@@ -228,7 +235,7 @@ void inode_close(struct inode *inode) {
 	    free_map_release(inode->sector, 1);
         }
 
-        free(inode); 
+        kmem_cache_free(inode_cache, inode);
     }
 }
 
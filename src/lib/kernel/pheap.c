@@ -0,0 +1,192 @@
+#include "pheap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every node is less than or
+   equal to its children, stored as a first child and a list of
+   siblings.  Two heaps are melded by making the greater root the
+   first child of the lesser one.  Popping the root melds its
+   children in pairs, left to right, and then melds the pairs
+   right to left, which is what keeps the amortized cost of a pop
+   logarithmic.
+
+   The `prev' link of a first child points to its parent, so an
+   element can be cut out of the tree without searching for it. */
+
+/* Melds the heaps rooted at A and B, either of which may be null,
+   and returns the root of the result.  A and B must not have
+   siblings. */
+static struct pheap_elem *
+meld (struct pheap *heap, struct pheap_elem *a, struct pheap_elem *b) 
+{
+  struct pheap_elem *t;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (heap->less (b, a, heap->aux)) 
+    {
+      t = a;
+      a = b;
+      b = t;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Melds the list of siblings starting at FIRST into one heap and
+   returns its root, or a null pointer if FIRST is null. */
+static struct pheap_elem *
+merge_pairs (struct pheap *heap, struct pheap_elem *first) 
+{
+  struct pheap_elem *pairs = NULL;
+  struct pheap_elem *root = NULL;
+  struct pheap_elem *a, *b, *rest;
+
+  /* Meld siblings in pairs, left to right, stacking the results
+     in reverse order through their `next' links. */
+  while (first != NULL) 
+    {
+      a = first;
+      b = a->next;
+      rest = b != NULL ? b->next : NULL;
+
+      a->prev = a->next = NULL;
+      if (b != NULL)
+        b->prev = b->next = NULL;
+
+      a = meld (heap, a, b);
+      a->next = pairs;
+      pairs = a;
+      first = rest;
+    }
+
+  /* Meld the pairs right to left. */
+  while (pairs != NULL) 
+    {
+      rest = pairs->next;
+      pairs->next = NULL;
+      root = meld (heap, root, pairs);
+      pairs = rest;
+    }
+
+  return root;
+}
+
+/* Detaches E, with its children, from its parent and siblings.
+   E must not be the root. */
+static void
+cut (struct pheap_elem *e) 
+{
+  ASSERT (e->prev != NULL);
+
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->prev = e->next = NULL;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+pheap_init (struct pheap *heap, pheap_less_func *less, void *aux) 
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+pheap_push (struct pheap *heap, struct pheap_elem *elem) 
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+  heap->size++;
+}
+
+/* Returns the least element in HEAP without removing it.
+   Undefined behavior if HEAP is empty. */
+struct pheap_elem *
+pheap_top (struct pheap *heap) 
+{
+  ASSERT (!pheap_empty (heap));
+  return heap->root;
+}
+
+/* Removes and returns the least element in HEAP.  Among equal
+   elements, which one is returned is unspecified, so a caller
+   that needs FIFO order should break ties in its less function.
+   Undefined behavior if HEAP is empty. */
+struct pheap_elem *
+pheap_pop (struct pheap *heap) 
+{
+  struct pheap_elem *top;
+
+  ASSERT (!pheap_empty (heap));
+
+  top = heap->root;
+  heap->root = merge_pairs (heap, top->child);
+  heap->size--;
+  return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+pheap_remove (struct pheap *heap, struct pheap_elem *elem) 
+{
+  ASSERT (!pheap_empty (heap));
+
+  if (elem == heap->root) 
+    pheap_pop (heap);
+  else 
+    {
+      cut (elem);
+      heap->root = meld (heap, heap->root, merge_pairs (heap, elem->child));
+      heap->size--;
+    }
+}
+
+/* Restores the heap order after ELEM, which must be in HEAP, has
+   become less than it was.  ELEM must not have become greater. */
+void
+pheap_raise (struct pheap *heap, struct pheap_elem *elem) 
+{
+  ASSERT (!pheap_empty (heap));
+
+  if (elem != heap->root) 
+    {
+      cut (elem);
+      heap->root = meld (heap, heap->root, elem);
+    }
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+pheap_size (struct pheap *heap) 
+{
+  return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+pheap_empty (struct pheap *heap) 
+{
+  return heap->root == NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef __LIB_KERNEL_PHEAP_H
+#define __LIB_KERNEL_PHEAP_H
+
+/* Pairing heap.
+
+   A priority queue that, like our lists, needs no dynamically
+   allocated memory: each structure that may be in a heap embeds a
+   struct pheap_elem, and pheap_entry() converts an element back to
+   its enclosing structure.
+
+   The heap is ordered by a "less" function supplied at
+   initialization.  The top of the heap is the element that is less
+   than all others, so to pop the highest-priority thread first, the
+   less function should return true for the higher priority.
+
+   Pushing, peeking at the top and raising an element are O(1);
+   popping and removing an arbitrary element are amortized
+   O(log n). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct pheap_elem 
+  {
+    struct pheap_elem *child;   /* First child. */
+    struct pheap_elem *next;    /* Next sibling. */
+    struct pheap_elem *prev;    /* Previous sibling, or parent if first. */
+  };
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool pheap_less_func (const struct pheap_elem *a,
+                              const struct pheap_elem *b,
+                              void *aux);
+
+/* Heap. */
+struct pheap 
+  {
+    struct pheap_elem *root;    /* Top of the heap, or null if empty. */
+    size_t size;                /* Number of elements. */
+    pheap_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Converts pointer to heap element PHEAP_ELEM into a pointer to
+   the structure that PHEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define pheap_entry(PHEAP_ELEM, STRUCT, MEMBER)         \
+        ((STRUCT *) ((uint8_t *) &(PHEAP_ELEM)->next    \
+                     - offsetof (STRUCT, MEMBER.next)))
+
+void pheap_init (struct pheap *, pheap_less_func *, void *aux);
+
+void pheap_push (struct pheap *, struct pheap_elem *);
+struct pheap_elem *pheap_top (struct pheap *);
+struct pheap_elem *pheap_pop (struct pheap *);
+void pheap_remove (struct pheap *, struct pheap_elem *);
+void pheap_raise (struct pheap *, struct pheap_elem *);
+
+size_t pheap_size (struct pheap *);
+bool pheap_empty (struct pheap *);
+
+#endif /* lib/kernel/pheap.h */
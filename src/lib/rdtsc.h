@@ -0,0 +1,15 @@
+#ifndef __LIB_RDTSC_H
+#define __LIB_RDTSC_H
+
+#include <stdint.h>
+
+/*! Returns the CPU's time-stamp counter, which counts cycles since
+    reset.  Used both by the kernel clock and by the benchmarks, in
+    the kernel and in user programs alike. */
+static inline uint64_t rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+#endif /* lib/rdtsc.h */
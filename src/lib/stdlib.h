@@ -2,6 +2,7 @@
  *
  * Declarations for standard functions atoi(), qsort(), and bsearch(),
  * as well as nonstandard functions sort() and binary_search().
+ * User programs also get malloc() and friends from lib/user/stdlib.h.
  */
 
 #ifndef __LIB_STDLIB_H
@@ -9,6 +10,10 @@
 
 #include <stddef.h>
 
+/* Include lib/user/stdlib.h or lib/kernel/stdlib.h, as
+   appropriate. */
+#include_next <stdlib.h>
+
 /* Standard functions. */
 int atoi(const char *);
 void qsort(void *array, size_t cnt, size_t size,
@@ -1,5 +1,36 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* memcpy(), memmove() and memset() move 32-bit words with the
+   string instructions, after moving single bytes until the
+   destination is word-aligned, and finish with the bytes left
+   over.  Blocks shorter than STRING_WORD_MIN bytes are moved a
+   byte at a time, which is cheaper than the setup.  The kernel is
+   built with -msoft-float and does not save SSE state across
+   context switches, so there are no SSE versions. */
+#define STRING_WORD_MIN 16
+
+/* A 32-bit word that may alias any object, for memcmp(). */
+typedef uint32_t __attribute__ ((may_alias)) string_word;
+
+/* Copies SIZE bytes forward from SRC to DST.  Also correct for
+   overlapping blocks as long as DST is below SRC. */
+static inline void copy_forward(unsigned char *dst,
+                                const unsigned char *src, size_t size) {
+    if (size >= STRING_WORD_MIN) {
+        size_t head = -(uintptr_t) dst & 3;
+        size_t words = (size - head) / 4;
+
+        size = (size - head) & 3;
+        asm volatile ("rep movsb"
+                      : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+        asm volatile ("rep movsl"
+                      : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+    asm volatile ("rep movsb"
+                  : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
 
 /*! Copies SIZE bytes from SRC to DST, which must not overlap.
     Returns DST. */
@@ -10,8 +41,7 @@ void * memcpy(void *dst_, const void *src_, size_t size) {
     ASSERT(dst != NULL || size == 0);
     ASSERT(src != NULL || size == 0);
 
-    while (size-- > 0)
-        *dst++ = *src++;
+    copy_forward(dst, src, size);
 
     return dst_;
 }
@@ -25,18 +55,29 @@ void * memmove(void *dst_, const void *src_, size_t size) {
     ASSERT(dst != NULL || size == 0);
     ASSERT(src != NULL || size == 0);
 
-    if (dst < src) {
-        while (size-- > 0)
-            *dst++ = *src++;
-    }
+    if (dst <= src || dst >= src + size)
+        copy_forward(dst, src, size);
     else {
-        dst += size;
-        src += size;
-        while (size-- > 0)
-            *--dst = *--src;
+        /* Copy backward, with the direction flag set: the odd bytes
+           at the end first, then the words.  One asm statement, so
+           that no compiled code runs with the flag set. */
+        size_t tail = size & 3;
+        size_t words = size / 4;
+
+        dst += size - 1;
+        src += size - 1;
+        asm volatile ("std\n\t"
+                      "rep movsb\n\t"
+                      "subl $3, %%edi\n\t"
+                      "subl $3, %%esi\n\t"
+                      "movl %3, %%ecx\n\t"
+                      "rep movsl\n\t"
+                      "cld"
+                      : "+D" (dst), "+S" (src), "+c" (tail)
+                      : "r" (words) : "memory");
     }
 
-    return dst;
+    return dst_;
 }
 
 /*! Find the first differing byte in the two blocks of SIZE bytes
@@ -50,6 +91,11 @@ int memcmp(const void *a_, const void *b_, size_t size) {
     ASSERT(a != NULL || size == 0);
     ASSERT(b != NULL || size == 0);
 
+    /* Skip equal words, then find the differing byte. */
+    for (; size >= 4; a += 4, b += 4, size -= 4) {
+        if (*(const string_word *) a != *(const string_word *) b)
+            break;
+    }
     for (; size-- > 0; a++, b++) {
         if (*a != *b)
             return *a > *b ? +1 : -1;
@@ -270,8 +316,19 @@ void * memset(void *dst_, int value, size_t size) {
 
     ASSERT(dst != NULL || size == 0);
 
-    while (size-- > 0)
-        *dst++ = value;
+    if (size >= STRING_WORD_MIN) {
+        size_t head = -(uintptr_t) dst & 3;
+        size_t words = (size - head) / 4;
+        uint32_t word = (unsigned char) value * 0x01010101u;
+
+        size = (size - head) & 3;
+        asm volatile ("rep stosb"
+                      : "+D" (dst), "+c" (head) : "a" (word) : "memory");
+        asm volatile ("rep stosl"
+                      : "+D" (dst), "+c" (words) : "a" (word) : "memory");
+    }
+    asm volatile ("rep stosb"
+                  : "+D" (dst), "+c" (size) : "a" (value) : "memory");
 
     return dst_;
 }
@@ -34,8 +34,18 @@ enum {
     SYS_MKDIR,                  /*!< Create a directory. */
     SYS_READDIR,                /*!< Reads a directory entry. */
     SYS_ISDIR,                  /*!< Tests if a fd represents a directory. */
-    SYS_INUMBER                 /*!< Returns the inode number for a fd. */
+    SYS_INUMBER,                /*!< Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /*!< Duplicate this process. */
+    SYS_CLOCK,                  /*!< Read the monotonic clock. */
+    SYS_SBRK,                   /*!< Move the end of the heap. */
+    SYS_MMAP_ANON               /*!< Map anonymous memory. */
 };
 
+/*! Flags for SYS_MMAP_ANON. */
+#define MAP_PRIVATE 0           /*!< Copied on write by fork(). */
+#define MAP_SHARED 1            /*!< Shared with children after fork(). */
+
 #endif /* lib/syscall-nr.h */
 
@@ -0,0 +1,277 @@
+/*! \file malloc.c
+ *
+ * Memory allocator for user programs, on top of sbrk().
+ *
+ * A request of up to 2 kB, counting an 8-byte header, is rounded up to
+ * a power of two from 16 bytes to 2 kB and served from the free list of
+ * that size class.  An empty list is refilled by carving a chunk of
+ * CHUNK_SIZE bytes, taken from sbrk(), into blocks of its size.  Small
+ * blocks go back to their list when freed and are never returned to
+ * the kernel.
+ *
+ * A larger request is rounded up to whole pages.  Freed large blocks
+ * are kept on a list sorted by address, merged with their free
+ * neighbours, and searched first-fit; a block that is larger than the
+ * request is split.  A free block that ends at the break is handed
+ * back to the kernel with a negative sbrk().
+ */
+
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/*! Size of the smallest size class. */
+#define MIN_SIZE 16
+
+/*! Number of size classes, 16 bytes through 2 kB. */
+#define CLASS_CNT 8
+
+/*! Size of the largest size class. */
+#define MAX_SMALL (MIN_SIZE << (CLASS_CNT - 1))
+
+/*! Bytes taken from sbrk() to refill a size class. */
+#define CHUNK_SIZE (16 * 1024)
+
+/*! Granularity of large blocks. */
+#define PAGE_SIZE 4096
+
+/*! Marks a block that is allocated, to catch bad calls to free(). */
+#define BLOCK_MAGIC 0x4d414c43
+
+/*! Header in front of every block. */
+struct header {
+    size_t size;                /*!< Bytes in the block, header included. */
+    unsigned magic;             /*!< BLOCK_MAGIC while allocated. */
+};
+
+/*! A free block. */
+struct free_block {
+    struct header h;
+    struct free_block *next;    /*!< Next block on the same list. */
+};
+
+/*! Free small blocks, one list per size class. */
+static struct free_block *free_lists[CLASS_CNT];
+
+/*! Free large blocks, in order of address. */
+static struct free_block *large_list;
+
+static void *heap_grow(size_t size);
+static struct free_block *refill(int class);
+static struct header *large_alloc(size_t size);
+static void large_free(struct free_block *);
+
+/*! Returns the size class of blocks of SIZE bytes, header included. */
+static int size_class(size_t size) {
+    int class = 0;
+
+    while ((size_t) (MIN_SIZE << class) < size)
+        class++;
+    return class;
+}
+
+/*! Obtains and returns a new block at least SIZE bytes long.
+    Returns a null pointer if memory is not available. */
+void *malloc(size_t size) {
+    struct header *h;
+    size_t need;
+
+    if (size == 0 || size > SIZE_MAX - PAGE_SIZE)
+        return NULL;
+
+    need = size + sizeof *h;
+    if (need <= MAX_SMALL) {
+        int class = size_class(need);
+        struct free_block *b = free_lists[class];
+
+        if (b == NULL && (b = refill(class)) == NULL)
+            return NULL;
+        free_lists[class] = b->next;
+        h = &b->h;
+    }
+    else {
+        h = large_alloc(ROUND_UP(need, PAGE_SIZE));
+        if (h == NULL)
+            return NULL;
+    }
+
+    h->magic = BLOCK_MAGIC;
+    return h + 1;
+}
+
+/*! Allocates and returns A times B bytes initialized to zeroes.
+    Returns a null pointer if memory is not available. */
+void *calloc(size_t a, size_t b) {
+    void *p;
+    size_t size;
+
+    /* Calculate block size and make sure it fits in size_t. */
+    size = a * b;
+    if (size < a || size < b)
+        return NULL;
+
+    /* Allocate and zero memory.  Recycled blocks are not zero. */
+    p = malloc(size);
+    if (p != NULL)
+        memset(p, 0, size);
+
+    return p;
+}
+
+/*! Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving it in
+    the process.  If successful, returns the new block; on failure,
+    returns a null pointer.  A call with null OLD_BLOCK is equivalent to
+    malloc(NEW_SIZE).  A call with zero NEW_SIZE is equivalent to
+    free(OLD_BLOCK). */
+void *realloc(void *old_block, size_t new_size) {
+    struct header *h;
+    size_t old_size;
+    void *new_block;
+
+    if (new_size == 0) {
+        free(old_block);
+        return NULL;
+    }
+    if (old_block == NULL)
+        return malloc(new_size);
+
+    h = (struct header *) old_block - 1;
+    ASSERT(h->magic == BLOCK_MAGIC);
+    old_size = h->size - sizeof *h;
+    if (new_size <= old_size)
+        return old_block;
+
+    new_block = malloc(new_size);
+    if (new_block != NULL) {
+        memcpy(new_block, old_block, old_size);
+        free(old_block);
+    }
+    return new_block;
+}
+
+/*! Frees block P, which must have been previously allocated with
+    malloc(), calloc(), or realloc(). */
+void free(void *p) {
+    struct free_block *b;
+
+    if (p == NULL)
+        return;
+
+    b = (struct free_block *) ((struct header *) p - 1);
+    ASSERT(b->h.magic == BLOCK_MAGIC);
+    b->h.magic = 0;
+
+    if (b->h.size <= MAX_SMALL) {
+        int class = size_class(b->h.size);
+        b->next = free_lists[class];
+        free_lists[class] = b;
+    }
+    else
+        large_free(b);
+}
+
+/*! Moves the break up by SIZE bytes, after aligning it to the size of a
+    header, and returns the start of the new memory.  Returns a null
+    pointer if the heap cannot grow that far. */
+static void *heap_grow(size_t size) {
+    uintptr_t brk = (uintptr_t) sbrk(0);
+    size_t pad = ROUND_UP(brk, sizeof (struct header)) - brk;
+    uint8_t *p;
+
+    if (size > SIZE_MAX - pad || (intptr_t) (size + pad) < 0)
+        return NULL;
+    p = sbrk(size + pad);
+    if (p == (void *) -1)
+        return NULL;
+    return p + pad;
+}
+
+/*! Carves a new chunk into free blocks of size class CLASS and returns
+    the first of them, with the rest on the free list.  Returns a null
+    pointer if memory is not available. */
+static struct free_block *refill(int class) {
+    size_t size = MIN_SIZE << class;
+    uint8_t *chunk = heap_grow(CHUNK_SIZE);
+    size_t ofs;
+
+    if (chunk == NULL)
+        return NULL;
+
+    for (ofs = 0; ofs < CHUNK_SIZE; ofs += size) {
+        struct free_block *b = (struct free_block *) (chunk + ofs);
+        b->h.size = size;
+        b->h.magic = 0;
+        b->next = ofs + size < CHUNK_SIZE
+                  ? (struct free_block *) (chunk + ofs + size) : NULL;
+    }
+    free_lists[class] = (struct free_block *) chunk;
+    return free_lists[class];
+}
+
+/*! Returns a large block of SIZE bytes, a multiple of PAGE_SIZE, from
+    the list of free large blocks or else from sbrk().  Returns a null
+    pointer if memory is not available. */
+static struct header *large_alloc(size_t size) {
+    struct free_block **bp;
+    struct header *h;
+
+    for (bp = &large_list; *bp != NULL; bp = &(*bp)->next) {
+        struct free_block *b = *bp;
+
+        if (b->h.size < size)
+            continue;
+
+        if (b->h.size > size) {
+            /* Split off the head, leaving the tail on the list. */
+            struct free_block *tail = (struct free_block *)
+                                      ((uint8_t *) b + size);
+            tail->h.size = b->h.size - size;
+            tail->h.magic = 0;
+            tail->next = b->next;
+            *bp = tail;
+            b->h.size = size;
+        }
+        else
+            *bp = b->next;
+        return &b->h;
+    }
+
+    h = heap_grow(size);
+    if (h != NULL)
+        h->size = size;
+    return h;
+}
+
+/*! Frees large block B, merging it with free neighbours, and gives
+    the result back to the kernel if it ends at the break. */
+static void large_free(struct free_block *b) {
+    struct free_block **bp = &large_list, **prev_bp = NULL;
+
+    /* Insert B in the list, which is sorted by address. */
+    while (*bp != NULL && *bp < b) {
+        prev_bp = bp;
+        bp = &(*bp)->next;
+    }
+    b->next = *bp;
+    *bp = b;
+
+    /* Coalesce with the following block, then the preceding one. */
+    if (b->next != NULL && (uint8_t *) b + b->h.size == (uint8_t *) b->next) {
+        b->h.size += b->next->h.size;
+        b->next = b->next->next;
+    }
+    if (prev_bp != NULL
+        && (uint8_t *) *prev_bp + (*prev_bp)->h.size == (uint8_t *) b) {
+        (*prev_bp)->h.size += b->h.size;
+        (*prev_bp)->next = b->next;
+        bp = prev_bp;
+        b = *bp;
+    }
+
+    if ((uint8_t *) b + b->h.size == sbrk(0)
+        && sbrk(-(intptr_t) b->h.size) != (void *) -1)
+        *bp = b->next;
+}
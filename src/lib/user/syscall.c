@@ -153,3 +153,21 @@ int inumber(int fd) {
     return syscall1(SYS_INUMBER, fd);
 }
 
+pid_t fork(void) {
+    return syscall0(SYS_FORK);
+}
+
+uint64_t clock_ns(void) {
+    uint64_t ns;
+    syscall1(SYS_CLOCK, &ns);
+    return ns;
+}
+
+void *sbrk(intptr_t increment) {
+    return (void *) syscall1(SYS_SBRK, increment);
+}
+
+mapid_t mmap_anon(void *addr, size_t length, int flags) {
+    return syscall3(SYS_MMAP_ANON, addr, length, flags);
+}
+
@@ -2,7 +2,10 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
+#include <syscall-nr.h>
 
 /*! Process identifier. */
 typedef int pid_t;
@@ -45,5 +48,11 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Extensions. */
+pid_t fork(void);
+uint64_t clock_ns(void);
+void *sbrk(intptr_t increment);
+mapid_t mmap_anon(void *addr, size_t length, int flags);
+
 #endif /* lib/user/syscall.h */
 
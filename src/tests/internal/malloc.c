@@ -0,0 +1,120 @@
+/*! \file malloc.c
+   Stress test and benchmark for threads/malloc.c.
+
+   Several threads allocate, fill, check and free blocks of random
+   sizes at the same time, keeping a random number of blocks live
+   so that their magazines run both full and empty and trade with
+   the depots.  Each thread then times malloc() and free() pairs of
+   one size, which should nearly always hit its magazine.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rdtsc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/test.h"
+#include "threads/thread.h"
+
+/*! Number of threads. */
+#define THREAD_CNT 4
+
+/*! Most blocks a thread keeps allocated at once. */
+#define LIVE_MAX 64
+
+/*! Allocations per thread in the stress phase. */
+#define STRESS_CNT 20000
+
+/*! Timed malloc() and free() pairs per thread. */
+#define PAIR_CNT 10000
+
+/*! A live block. */
+struct live {
+    uint8_t *p;                 /*!< The block. */
+    size_t size;                /*!< Its size. */
+    uint8_t fill;               /*!< Byte it was filled with. */
+};
+
+static struct semaphore done;
+static uint64_t pair_cycles[THREAD_CNT];
+
+static thread_func stress_thread;
+static void check_block(const struct live *);
+
+/*! Run the malloc stress test and benchmark. */
+void test(void) {
+    int i;
+
+    sema_init(&done, 0);
+    printf("testing malloc with %d threads:", THREAD_CNT);
+    for (i = 0; i < THREAD_CNT; i++) {
+        char name[16];
+        snprintf(name, sizeof name, "malloc %d", i);
+        thread_create(name, PRI_DEFAULT, stress_thread, pair_cycles + i);
+    }
+    for (i = 0; i < THREAD_CNT; i++)
+        sema_down(&done);
+    printf(" done\n");
+
+    for (i = 0; i < THREAD_CNT; i++)
+        printf("thread %d: %llu cycles per 32-byte malloc and free\n",
+               i, pair_cycles[i] / PAIR_CNT);
+    malloc_print_stats();
+    printf("malloc: PASS\n");
+}
+
+/*! Allocates and frees random blocks, checking that none of them
+    is handed out twice, then times malloc() and free() pairs into
+    *CYCLES_. */
+static void stress_thread(void *cycles_) {
+    uint64_t *cycles = cycles_;
+    struct live live[LIVE_MAX];
+    size_t live_cnt = 0;
+    uint64_t start;
+    int i;
+
+    for (i = 0; i < STRESS_CNT; i++) {
+        if (live_cnt < LIVE_MAX && (live_cnt == 0 || random_ulong() % 2)) {
+            struct live *l = &live[live_cnt];
+            l->size = 1 + random_ulong() % 1500;
+            l->fill = random_ulong();
+            l->p = malloc(l->size);
+            ASSERT(l->p != NULL);
+            memset(l->p, l->fill, l->size);
+            live_cnt++;
+        }
+        else {
+            size_t j = random_ulong() % live_cnt;
+            check_block(&live[j]);
+            free(live[j].p);
+            live[j] = live[--live_cnt];
+        }
+    }
+    while (live_cnt > 0) {
+        check_block(&live[--live_cnt]);
+        free(live[live_cnt].p);
+    }
+
+    start = rdtsc();
+    for (i = 0; i < PAIR_CNT; i++)
+        free(malloc(32));
+    *cycles = rdtsc() - start;
+
+    printf(" %s", thread_name());
+    sema_up(&done);
+}
+
+/*! Verifies that block L still holds the bytes it was filled with. */
+static void check_block(const struct live *l) {
+    size_t i;
+
+    for (i = 0; i < l->size; i++)
+        ASSERT(l->p[i] == l->fill);
+}
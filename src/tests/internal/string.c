@@ -0,0 +1,175 @@
+/*! \file string.c
+   Test program and benchmark for the block functions of
+   lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time versions for every size up to 80 bytes and a few
+   larger ones, at every alignment of source and destination, and
+   for memmove() with every overlap in either direction.  Then
+   times each function for sizes from 16 bytes to a page, both
+   word-aligned and misaligned by one byte.
+
+   The same file is the body of the examples/strbench user
+   program, so that the kernel and libc.a copies of lib/string.c
+   can be compared.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rdtsc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*! Largest block checked or timed. */
+#define MAX_SIZE 4096
+
+/*! Calls timed per size and alignment. */
+#define ITER_CNT 1000
+
+void test(void);
+
+static unsigned char src[MAX_SIZE + 8], dst[MAX_SIZE + 8], ref[MAX_SIZE + 8];
+
+static void check_sizes(size_t size);
+static void fill(unsigned char *, size_t, unsigned seed);
+static void copy_bytes(unsigned char *, const unsigned char *, size_t);
+static bool same_bytes(const unsigned char *, const unsigned char *, size_t);
+static void bench(size_t size, size_t misalign);
+
+/*! Check and time the block functions. */
+void test(void) {
+    static const size_t big_sizes[] = { 127, 128, 255, 1000, 4093, MAX_SIZE };
+    static const size_t bench_sizes[] = { 16, 64, 256, 1024, MAX_SIZE };
+    size_t i, size;
+
+    printf("testing block functions:");
+    for (size = 0; size <= 80; size++)
+        check_sizes(size);
+    for (i = 0; i < sizeof big_sizes / sizeof *big_sizes; i++)
+        check_sizes(big_sizes[i]);
+    printf(" done\n");
+
+    printf("%6s %5s %8s %8s %8s %8s  (cycles per call)\n",
+           "size", "align", "memcpy", "memmove", "memset", "memcmp");
+    for (i = 0; i < sizeof bench_sizes / sizeof *bench_sizes; i++) {
+        bench(bench_sizes[i], 0);
+        bench(bench_sizes[i], 1);
+    }
+    printf("string: PASS\n");
+}
+
+/*! Checks each function on blocks of SIZE bytes at every
+    alignment. */
+static void check_sizes(size_t size) {
+    size_t s, d, j;
+
+    for (s = 0; s < 4; s++)
+        for (d = 0; d < 4; d++) {
+            /* memcpy(). */
+            fill(src, sizeof src, s * 4 + d);
+            fill(dst, sizeof dst, 99);
+            copy_bytes(ref, dst, sizeof ref);
+            for (j = 0; j < size; j++)
+                ref[d + j] = src[s + j];
+            ASSERT(memcpy(dst + d, src + s, size) == dst + d);
+            ASSERT(same_bytes(dst, ref, sizeof ref));
+
+            /* memset(). */
+            for (j = 0; j < size; j++)
+                ref[d + j] = 0xa5;
+            ASSERT(memset(dst + d, 0x1a5, size) == dst + d);
+            ASSERT(same_bytes(dst, ref, sizeof ref));
+
+            /* memcmp(), with one byte changed. */
+            copy_bytes(dst, src, sizeof dst);
+            ASSERT(memcmp(dst + s, src + s, size) == 0);
+            if (size > 0) {
+                dst[s + size / 2 + d % 2 * (size - 1) / 2]++;
+                ASSERT(memcmp(dst + s, src + s, size) != 0);
+                ASSERT(memcmp(dst + s, src + s, size)
+                       == -memcmp(src + s, dst + s, size));
+            }
+        }
+
+    /* memmove(), every overlap in either direction. */
+    if (size <= 80)
+        for (s = 0; s < 8; s++)
+            for (d = 0; d < 8; d++) {
+                fill(dst, sizeof dst, s * 8 + d);
+                copy_bytes(ref, dst, sizeof ref);
+                for (j = 0; j < size; j++)
+                    src[j] = ref[s + j];
+                for (j = 0; j < size; j++)
+                    ref[d + j] = src[j];
+                ASSERT(memmove(dst + d, dst + s, size) == dst + d);
+                ASSERT(same_bytes(dst, ref, sizeof ref));
+            }
+    printf(".");
+}
+
+/*! Fills the SIZE bytes at P with a pattern that depends on SEED. */
+static void fill(unsigned char *p, size_t size, unsigned seed) {
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        p[i] = (i * 7 + seed * 13 + (i >> 8)) & 0xff;
+}
+
+/*! Copies SIZE bytes from SRC to DST one at a time, so that the
+    checks do not depend on the functions under test. */
+static void copy_bytes(unsigned char *dst, const unsigned char *src,
+                       size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        dst[i] = src[i];
+}
+
+/*! Returns true if the SIZE bytes at A and B are equal, comparing
+    them one at a time. */
+static bool same_bytes(const unsigned char *a, const unsigned char *b,
+                       size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+/*! Prints cycles per call for blocks of SIZE bytes, with both
+    blocks misaligned by MISALIGN bytes. */
+static void bench(size_t size, size_t misalign) {
+    uint64_t start, cpy, move, set, cmp;
+    int i;
+
+    start = rdtsc();
+    for (i = 0; i < ITER_CNT; i++)
+        memcpy(dst + misalign, src + misalign, size);
+    cpy = rdtsc() - start;
+
+    start = rdtsc();
+    for (i = 0; i < ITER_CNT; i++)
+        memmove(dst + misalign + 4, dst + misalign, size - 4);
+    move = rdtsc() - start;
+
+    start = rdtsc();
+    for (i = 0; i < ITER_CNT; i++)
+        memset(dst + misalign, i, size);
+    set = rdtsc() - start;
+
+    memcpy(src, dst, sizeof src);
+    start = rdtsc();
+    for (i = 0; i < ITER_CNT; i++)
+        if (memcmp(dst + misalign, src + misalign, size) != 0)
+            PANIC("memcmp() of equal blocks");
+    cmp = rdtsc() - start;
+
+    printf("%6zu %5zu %8llu %8llu %8llu %8llu\n", size, misalign,
+           cpy / ITER_CNT, move / ITER_CNT, set / ITER_CNT, cmp / ITER_CNT);
+}
@@ -0,0 +1,93 @@
+/* Puts thousands of threads to sleep until the same tick and reports
+   how late the last of them got to run.
+
+   Every sleeper registers its alarm as soon as it is created, so a
+   timer that can file only a few alarms per tick shows up as sleepers
+   that are registered after their wake-up tick has passed.  The
+   lateness also includes the time to switch through all the woken
+   threads, so it is printed rather than checked; only early wake-ups
+   are reported as failures. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static const int thread_cnts[] = {1000, 2000, 3000};
+
+/* Ticks between the start of a run and the common wake-up tick,
+   long enough to create every sleeper first. */
+#define START_DELAY 500
+
+/* Information about the test. */
+struct sleep_test 
+  {
+    int64_t wake_at;            /* Tick every sleeper waits for. */
+    int64_t max_late;           /* Largest lateness seen, in ticks. */
+    int early_cnt;              /* # of sleepers that woke too soon. */
+    struct semaphore done;      /* Upped by each sleeper as it exits. */
+  };
+
+static thread_func sleeper;
+
+static void
+test_sleep (int thread_cnt) 
+{
+  struct sleep_test test;
+  int i;
+
+  test.wake_at = timer_ticks () + START_DELAY;
+  test.max_late = 0;
+  test.early_cnt = 0;
+  sema_init (&test.done, 0);
+
+  /* Sleepers outrank us, so each one runs and registers its alarm
+     as soon as it is created. */
+  for (i = 0; i < thread_cnt; i++)
+    {
+      char name[24];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT + 1, sleeper, &test)
+          == TID_ERROR)
+        fail ("could not create %d threads", thread_cnt);
+    }
+
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&test.done);
+
+  if (test.early_cnt > 0)
+    fail ("%d of %d threads woke up early", test.early_cnt, thread_cnt);
+  msg ("%d threads woke up, the last one %lld ticks late",
+       thread_cnt, test.max_late);
+}
+
+void
+test_alarm_many (void) 
+{
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  for (i = 0; i < sizeof thread_cnts / sizeof *thread_cnts; i++)
+    test_sleep (thread_cnts[i]);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *test_) 
+{
+  struct sleep_test *test = test_;
+  int64_t late;
+
+  timer_sleep (test->wake_at - timer_ticks ());
+
+  late = timer_ticks () - test->wake_at;
+  if (late < 0)
+    test->early_cnt++;
+  else if (late > test->max_late)
+    test->max_late = late;
+  sema_up (&test->done);
+}
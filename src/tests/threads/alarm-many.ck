@@ -0,0 +1,13 @@
+# -*- perl -*-
+
+# The expected output looks like this, with host-dependent lateness:
+#
+# (alarm-many) 1000 threads woke up, the last one 0 ticks late
+# (alarm-many) 2000 threads woke up, the last one 1 ticks late
+# (alarm-many) 3000 threads woke up, the last one 1 ticks late
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::timing;
+check_timing (qr/(\d+) threads woke up, the last one \d+ ticks late/, "1000 2000 3000");
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-simultaneous-tickless) begin
+(alarm-simultaneous-tickless) Creating 3 threads to sleep 5 times each.
+(alarm-simultaneous-tickless) Each thread sleeps 10 ticks each time.
+(alarm-simultaneous-tickless) Within an iteration, all threads should wake up on the same tick.
+(alarm-simultaneous-tickless) iteration 0, thread 0: woke up after 10 ticks
+(alarm-simultaneous-tickless) iteration 0, thread 1: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 0, thread 2: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 1, thread 0: woke up 10 ticks later
+(alarm-simultaneous-tickless) iteration 1, thread 1: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 1, thread 2: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 2, thread 0: woke up 10 ticks later
+(alarm-simultaneous-tickless) iteration 2, thread 1: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 2, thread 2: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 3, thread 0: woke up 10 ticks later
+(alarm-simultaneous-tickless) iteration 3, thread 1: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 3, thread 2: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 4, thread 0: woke up 10 ticks later
+(alarm-simultaneous-tickless) iteration 4, thread 1: woke up 0 ticks later
+(alarm-simultaneous-tickless) iteration 4, thread 2: woke up 0 ticks later
+(alarm-simultaneous-tickless) end
+EOF
+pass;
@@ -0,0 +1,107 @@
+/* Measures the cycles saved by the fast path of uncontended locking.
+
+   Times, with the CPU's time-stamp counter, a lock_acquire() and
+   lock_release() pair on a lock nobody else wants, as every system
+   call does with the file system lock, and a sema_try_down() and
+   sema_up() pair on a free semaphore, as every cache_read() does
+   with the semaphore of its cache entry.  Each pair is timed on the
+   compare-and-swap fast path and again with sema_fast_path cleared,
+   which forces the slow path that disables interrupts, walks the
+   donation chain and calls maybe_yield().
+
+   Fails if the fast path took the slow path even once.  The cycle
+   counts depend on the host and are only printed, not checked. */
+
+#include <rdtsc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define PAIR_CNT 100000         /* Pairs timed per primitive and path. */
+
+typedef uint64_t time_func (void *aux);
+static time_func time_lock, time_sema;
+static void report (const char *name, const char *pair,
+                    time_func *, void *aux);
+
+void
+test_lock_fast (void)
+{
+  struct lock lock;
+  struct semaphore sema;
+
+  lock_init (&lock);
+  sema_init (&sema, 1);
+
+  report ("lock", "acquire and release", time_lock, &lock);
+  report ("semaphore", "down and up", time_sema, &sema);
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (lock.holder == NULL);
+}
+
+/* Returns the cycles taken by PAIR_CNT acquire and release pairs on
+   the lock LOCK_. */
+static uint64_t
+time_lock (void *lock_)
+{
+  struct lock *lock = lock_;
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < PAIR_CNT; i++)
+    {
+      lock_acquire (lock);
+      lock_release (lock);
+    }
+  return rdtsc () - start;
+}
+
+/* Returns the cycles taken by PAIR_CNT down and up pairs on the
+   semaphore SEMA_. */
+static uint64_t
+time_sema (void *sema_)
+{
+  struct semaphore *sema = sema_;
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < PAIR_CNT; i++)
+    {
+      if (!sema_try_down (sema))
+        fail ("sema_try_down() failed on a free semaphore");
+      sema_up (sema);
+    }
+  return rdtsc () - start;
+}
+
+/* Times FUNC(AUX) on the fast path and then on the slow path,
+   checks from sema_slow_cnt that each took the path it should
+   have, and prints the cost of one PAIR under NAME. */
+static void
+report (const char *name, const char *pair,
+        time_func *func, void *aux)
+{
+  uint64_t slow_cnt, fast, slow;
+
+  slow_cnt = sema_slow_cnt;
+  fast = func (aux) / PAIR_CNT;
+  if (sema_slow_cnt != slow_cnt)
+    fail ("%s: %llu of %d pairs took the slow path", name,
+          sema_slow_cnt - slow_cnt, PAIR_CNT);
+
+  sema_fast_path = false;
+  slow_cnt = sema_slow_cnt;
+  slow = func (aux) / PAIR_CNT;
+  sema_fast_path = true;
+  if (sema_slow_cnt - slow_cnt < 2 * PAIR_CNT)
+    fail ("%s: only %llu slow paths taken for %d pairs", name,
+          sema_slow_cnt - slow_cnt, PAIR_CNT);
+
+  msg ("%s: %llu cycles per %s, %llu on the slow path, %lld saved",
+       name, fast, pair, slow, (long long) (slow - fast));
+}
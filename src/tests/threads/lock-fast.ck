@@ -0,0 +1,13 @@
+# -*- perl -*-
+
+# The expected output looks like this, with host-dependent cycle counts:
+#
+# (lock-fast) lock: 123 cycles per acquire and release, 456 on the slow path, 333 saved
+# (lock-fast) semaphore: 123 cycles per down and up, 456 on the slow path, 333 saved
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::timing;
+check_timing (qr/\(lock-fast\) (\w+): \d+ cycles per .*, \d+ on the slow path, -?\d+ saved/,
+	      "lock semaphore");
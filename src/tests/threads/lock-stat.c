@@ -0,0 +1,50 @@
+/* Checks the statistics kept for a lock under -lockstat.
+
+   The main thread acquires and releases a lock once without
+   contention, then acquires it again and starts a higher-priority
+   thread that has to wait for it.  The lock's statistics must show
+   three acquisitions, one of them contended by that thread. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static struct lock stat_lock;
+
+static thread_func contender_thread;
+
+void
+test_lock_stat (void)
+{
+  struct lock_stat ls;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_stat_enabled = true;
+  lock_init (&stat_lock);
+
+  lock_acquire (&stat_lock);
+  lock_release (&stat_lock);
+
+  lock_acquire (&stat_lock);
+  thread_create ("contender", PRI_DEFAULT + 1, contender_thread, NULL);
+  msg ("Releasing the lock.");
+  lock_release (&stat_lock);
+
+  if (!lock_stat_get ("stat_lock", &ls))
+    fail ("no statistics for stat_lock");
+  msg ("%llu acquired, %llu contended, last contender %s.",
+       ls.acquired, ls.contended, ls.last_contender);
+}
+
+static void
+contender_thread (void *aux UNUSED)
+{
+  lock_acquire (&stat_lock);
+  msg ("Contender got the lock.");
+  lock_release (&stat_lock);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lock-stat) begin
+(lock-stat) Releasing the lock.
+(lock-stat) Contender got the lock.
+(lock-stat) 3 acquired, 1 contended, last contender contender.
+(lock-stat) end
+EOF
+pass;
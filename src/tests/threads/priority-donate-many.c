@@ -0,0 +1,97 @@
+/* The main thread acquires a lock, then creates hundreds of
+   higher-priority threads that all block acquiring it, spread
+   over 30 priorities.  Each new waiter donates its priority to
+   the main thread, which checks that it always runs at the
+   highest donated priority.  When the main thread releases the
+   lock, the waiters must get it highest priority first, and in
+   the order they arrived within each priority.
+
+   Also prints how long each handoff took, which grows with the
+   number of waiters if the wait queue is a sorted list. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 300
+#define LEVEL_CNT 30
+
+struct donate_test 
+  {
+    struct lock lock;           /* The contended lock. */
+    int order[WAITER_CNT];      /* Waiters in the order they got the lock. */
+    int cnt;                    /* Number of entries in ORDER. */
+  };
+
+static struct donate_test test;
+
+static thread_func waiter_thread_func;
+
+static int
+waiter_priority (int id) 
+{
+  return PRI_DEFAULT + 1 + id % LEVEL_CNT;
+}
+
+void
+test_priority_donate_many (void) 
+{
+  uint64_t start, end;
+  int i, level, next;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&test.lock);
+  test.cnt = 0;
+  lock_acquire (&test.lock);
+
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+      int expected = PRI_DEFAULT + (i < LEVEL_CNT ? i + 1 : LEVEL_CNT);
+
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, waiter_priority (i), waiter_thread_func,
+                     (void *) i);
+      if (thread_get_priority () != expected)
+        fail ("after %d waiters, main thread has priority %d, not %d",
+              i + 1, thread_get_priority (), expected);
+    }
+  msg ("%d threads waiting on the lock, main thread priority %d.",
+       WAITER_CNT, thread_get_priority ());
+
+  start = timer_now_ns ();
+  lock_release (&test.lock);
+  end = timer_now_ns ();
+  msg ("Main thread priority after release: %d.", thread_get_priority ());
+
+  if (test.cnt != WAITER_CNT)
+    fail ("%d of %d waiters acquired the lock", test.cnt, WAITER_CNT);
+
+  next = 0;
+  for (level = LEVEL_CNT - 1; level >= 0; level--)
+    for (i = level; i < WAITER_CNT; i += LEVEL_CNT)
+      if (test.order[next++] != i)
+        fail ("waiter %d acquired the lock in place %d, expected waiter %d",
+              test.order[next - 1], next - 1, i);
+  msg ("All waiters acquired the lock in priority order.");
+
+  msg ("Handoffs took %llu ns each.", (end - start) / WAITER_CNT);
+}
+
+static void
+waiter_thread_func (void *id_) 
+{
+  int id = (int) id_;
+
+  lock_acquire (&test.lock);
+  test.order[test.cnt++] = id;
+  lock_release (&test.lock);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+# The handoff time depends on the host, so leave it out.
+my (@output) = grep (!/Handoffs took \d+ ns each/,
+		     read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(priority-donate-many) begin
+(priority-donate-many) 300 threads waiting on the lock, main thread priority 61.
+(priority-donate-many) Main thread priority after release: 31.
+(priority-donate-many) All waiters acquired the lock in priority order.
+(priority-donate-many) end
+EOF
+pass;
@@ -0,0 +1,112 @@
+/* Measures wakeup-to-run latency of the scheduler with 10, 100 and
+   1000 other threads ready to run.
+
+   The main thread shares its priority with N "filler" threads that
+   do nothing but yield, so every time it is preempted it is put
+   behind all of them in the run queue.  It then repeatedly wakes a
+   higher-priority thread with sema_up() and times, with the CPU's
+   time-stamp counter, how long that thread takes to start running.
+   The wakeup preempts the main thread, so the measured path covers
+   thread_unblock(), requeuing the main thread behind the fillers and
+   picking the next thread to run.
+
+   The numbers depend on the host and are only printed, not checked. */
+
+#include <rdtsc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAKEUP_CNT 200          /* Wakeups timed per run. */
+
+static const int ready_cnts[] = {10, 100, 1000};
+
+static volatile bool stop;      /* Tells filler and waker threads to exit. */
+static struct semaphore done;   /* Upped by each exiting thread. */
+
+static struct semaphore wake;   /* The waker thread sleeps here. */
+static struct semaphore woken;  /* ...and ups this once it has run. */
+static uint64_t wake_start;     /* Time stamp of the last sema_up(). */
+static uint64_t wake_total;     /* Sum of wakeup latencies. */
+
+static thread_func filler_thread;
+static thread_func waker_thread;
+
+static void
+measure (int ready_cnt)
+{
+  int i;
+
+  stop = false;
+  wake_total = 0;
+  sema_init (&done, 0);
+  sema_init (&wake, 0);
+  sema_init (&woken, 0);
+
+  for (i = 0; i < ready_cnt; i++)
+    {
+      char name[24];
+      snprintf (name, sizeof name, "filler %d", i);
+      if (thread_create (name, PRI_DEFAULT, filler_thread, NULL)
+          == TID_ERROR)
+        fail ("could not create %d ready threads", ready_cnt);
+    }
+
+  /* Higher priority than us: runs at once and blocks on WAKE. */
+  thread_create ("waker", PRI_DEFAULT + 1, waker_thread, NULL);
+
+  for (i = 0; i < WAKEUP_CNT; i++)
+    {
+      wake_start = rdtsc ();
+      sema_up (&wake);
+      sema_down (&woken);
+    }
+
+  stop = true;
+  sema_up (&wake);
+  for (i = 0; i < ready_cnt + 1; i++)
+    sema_down (&done);
+
+  msg ("%d ready threads: %llu cycles per wakeup",
+       ready_cnt, wake_total / WAKEUP_CNT);
+}
+
+void
+test_sched_latency (void)
+{
+  size_t i;
+
+  /* This test relies on fixed priorities. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < sizeof ready_cnts / sizeof *ready_cnts; i++)
+    measure (ready_cnts[i]);
+}
+
+static void
+filler_thread (void *aux UNUSED)
+{
+  while (!stop)
+    thread_yield ();
+  sema_up (&done);
+}
+
+static void
+waker_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&wake);
+      if (stop)
+        break;
+      wake_total += rdtsc () - wake_start;
+      sema_up (&woken);
+    }
+  sema_up (&done);
+}
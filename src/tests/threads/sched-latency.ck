@@ -0,0 +1,13 @@
+# -*- perl -*-
+
+# The expected output looks like this, with host-dependent cycle counts:
+#
+# (sched-latency) 10 ready threads: 1234 cycles per wakeup
+# (sched-latency) 100 ready threads: 1234 cycles per wakeup
+# (sched-latency) 1000 ready threads: 1234 cycles per wakeup
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::timing;
+check_timing (qr/(\d+) ready threads: \d+ cycles per wakeup/, "10 100 1000");
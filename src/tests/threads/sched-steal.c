@@ -0,0 +1,80 @@
+/* Checks that a CPU whose run queue is empty steals ready
+   threads from the other CPUs.  Run with -cpus=4.
+
+   Eight threads of equal priority are spread over the CPUs as
+   they are created, two per CPU, and thread I yields (I + 1) * 50
+   times.  The CPUs that got the short threads run out of work
+   first and must take the long threads still waiting on the other
+   CPUs.  Each thread notes every time it finds itself on another
+   CPU after a yield, which only a steal can cause.  All threads
+   must finish, and at least one must have moved. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 8            /* Threads spread over the CPUs. */
+#define YIELD_STEP 50           /* Yields more per thread. */
+
+static struct semaphore done;   /* Upped by each thread as it exits. */
+static int move_cnt;            /* Times a thread changed CPUs. */
+
+static thread_func steal_thread;
+
+void
+test_sched_steal (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+  if (thread_cpu_cnt != 4)
+    fail ("must be run with -cpus=4, not %u CPUs", thread_cpu_cnt);
+
+  sema_init (&done, 0);
+  move_cnt = 0;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "steal %d", i);
+      thread_create (name, thread_get_priority (), steal_thread,
+                     (void *) ((i + 1) * YIELD_STEP));
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  msg ("%d threads finished on %u CPUs.", THREAD_CNT, thread_cpu_cnt);
+  if (move_cnt == 0)
+    fail ("no thread was stolen by another CPU");
+  msg ("Some of them were stolen by another CPU.");
+}
+
+/* Yields YIELD_CNT_ times, counting the yields after which it
+   runs on another CPU than before. */
+static void
+steal_thread (void *yield_cnt_)
+{
+  int yield_cnt = (int) yield_cnt_;
+  struct thread *t = thread_current ();
+  unsigned cpu = t->cpu;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < yield_cnt; i++)
+    {
+      thread_yield ();
+      if (t->cpu != cpu)
+        {
+          cpu = t->cpu;
+          old_level = intr_disable ();
+          move_cnt++;
+          intr_set_level (old_level);
+        }
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-steal) begin
+(sched-steal) 8 threads finished on 4 CPUs.
+(sched-steal) Some of them were stolen by another CPU.
+(sched-steal) end
+EOF
+pass;
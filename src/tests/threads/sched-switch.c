@@ -0,0 +1,88 @@
+/* Measures the cost of a context switch between two kernel
+   threads.
+
+   First the main thread and a partner of the same priority
+   ping-pong on a pair of semaphores, so that every round trip
+   blocks each thread once and switches twice.  Then both threads
+   call thread_yield() in a loop, so that every yield switches to
+   the other one.  Both times, taken with the CPU's time-stamp
+   counter, cover the scheduler, switch_threads() and
+   process_activate(), which need not reload CR3 when neither
+   thread has a page directory of its own.
+
+   The numbers depend on the host and are only printed, not checked. */
+
+#include <rdtsc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUND_CNT 10000         /* Round trips timed per method. */
+
+static struct semaphore ping;   /* The partner waits here... */
+static struct semaphore pong;   /* ...and the main thread here. */
+static struct semaphore done;   /* Upped by the partner as it exits. */
+
+static thread_func ping_pong_thread;
+static thread_func yield_thread;
+
+void
+test_sched_switch (void)
+{
+  uint64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  sema_init (&done, 0);
+
+  thread_create ("ping-pong", thread_get_priority (), ping_pong_thread, NULL);
+  start = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  msg ("semaphore: %llu cycles per switch",
+       (rdtsc () - start) / (2 * ROUND_CNT));
+  sema_down (&done);
+
+  thread_create ("yield", thread_get_priority (), yield_thread, NULL);
+  start = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++)
+    thread_yield ();
+  msg ("yield: %llu cycles per switch",
+       (rdtsc () - start) / (2 * ROUND_CNT));
+  sema_down (&done);
+}
+
+/* Answers each up of PING with an up of PONG. */
+static void
+ping_pong_thread (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+  sema_up (&done);
+}
+
+/* Yields back to the main thread as often as it yields to us. */
+static void
+yield_thread (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++)
+    thread_yield ();
+  sema_up (&done);
+}
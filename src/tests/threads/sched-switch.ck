@@ -0,0 +1,12 @@
+# -*- perl -*-
+
+# The expected output looks like this, with host-dependent cycle counts:
+#
+# (sched-switch) semaphore: 123 cycles per switch
+# (sched-switch) yield: 123 cycles per switch
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::timing;
+check_timing (qr/\(sched-switch\) (\w+): \d+ cycles per switch/, "semaphore yield");
@@ -17,6 +17,11 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-many", test_alarm_many},
+    {"alarm-single-tickless", test_alarm_single},
+    {"alarm-multiple-tickless", test_alarm_multiple},
+    {"alarm-simultaneous-tickless", test_alarm_simultaneous},
+    {"alarm-priority-tickless", test_alarm_priority},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +30,16 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-many", test_priority_donate_many},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"sched-latency", test_sched_latency},
+    {"sched-switch", test_sched_switch},
+    {"sched-steal", test_sched_steal},
+    {"lock-fast", test_lock_fast},
+    {"lock-stat", test_lock_stat},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
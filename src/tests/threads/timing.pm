@@ -0,0 +1,18 @@
+# Checks the output of a benchmark whose numbers depend on the host.
+# Only what REGEX captures from each line of output, such as the
+# name or size of each run, is checked, against the space-separated
+# EXPECTED list.
+sub check_timing {
+    my ($regex, $expected) = @_;
+    our ($test);
+
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    my (@runs) = map (/$regex/, @output);
+    fail "Expected runs \"$expected\", found \"@runs\".\n"
+      if "@runs" ne $expected;
+    pass;
+}
+
+1;
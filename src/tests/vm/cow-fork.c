@@ -0,0 +1,52 @@
+/* Fills 1 MB of memory, forks, and has the child overwrite it.  Checks
+   that each process keeps seeing its own data after the copy-on-write
+   split. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static char buf[SIZE];
+
+static void
+verify (char value)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, buf[i], value);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  msg ("fill");
+  memset (buf, 0x5a, sizeof buf);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: verify");
+      verify (0x5a);
+
+      msg ("child: overwrite");
+      memset (buf, 0xa5, sizeof buf);
+      verify (0xa5);
+      exit (81);
+    }
+
+  if (child == PID_ERROR)
+    fail ("fork failed");
+  if (wait (child) != 81)
+    fail ("wrong exit code from child");
+
+  msg ("parent: verify");
+  verify (0x5a);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cow-fork) begin
+(cow-fork) fill
+(cow-fork) fork
+(cow-fork) child: verify
+(cow-fork) child: overwrite
+cow-fork: exit(81)
+(cow-fork) parent: verify
+(cow-fork) end
+cow-fork: exit(0)
+EOF
+pass;
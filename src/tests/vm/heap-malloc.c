@@ -0,0 +1,94 @@
+/* Allocates, fills, checks and frees blocks of random sizes from
+   1 byte to 64 kB with malloc(), keeping up to 256 of them live
+   at once, then checks calloc() and realloc(). */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LIVE_MAX 256
+#define ROUND_CNT 4000
+
+struct live
+  {
+    uint8_t *p;
+    size_t size;
+    uint8_t fill;
+  };
+
+static struct live live[LIVE_MAX];
+
+static void
+check_block (const struct live *l)
+{
+  size_t i;
+
+  for (i = 0; i < l->size; i++)
+    if (l->p[i] != l->fill)
+      fail ("block of %zu bytes was overwritten at byte %zu", l->size, i);
+}
+
+void
+test_main (void)
+{
+  size_t live_cnt = 0;
+  uint8_t *p;
+  size_t i;
+  int round;
+
+  random_init (0);
+
+  msg ("random allocations");
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      if (live_cnt < LIVE_MAX && (live_cnt == 0 || random_ulong () % 2))
+        {
+          struct live *l = &live[live_cnt++];
+          l->size = random_ulong () % 8 == 0
+                    ? 4096 + random_ulong () % (60 * 1024)
+                    : 1 + random_ulong () % 2000;
+          l->fill = random_ulong ();
+          l->p = malloc (l->size);
+          if (l->p == NULL)
+            fail ("malloc(%zu) failed", l->size);
+          memset (l->p, l->fill, l->size);
+        }
+      else
+        {
+          size_t j = random_ulong () % live_cnt;
+          check_block (&live[j]);
+          free (live[j].p);
+          live[j] = live[--live_cnt];
+        }
+    }
+  while (live_cnt > 0)
+    {
+      check_block (&live[--live_cnt]);
+      free (live[live_cnt].p);
+    }
+
+  msg ("calloc");
+  p = calloc (1000, 10);
+  if (p == NULL)
+    fail ("calloc failed");
+  for (i = 0; i < 1000 * 10; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of calloc'd block is not zero", i);
+  free (p);
+
+  msg ("realloc");
+  p = NULL;
+  for (i = 1; i <= 64 * 1024; i *= 2)
+    {
+      p = realloc (p, i);
+      if (p == NULL)
+        fail ("realloc to %zu bytes failed", i);
+      if (i > 1 && p[i / 2 - 1] != (uint8_t) (i / 2))
+        fail ("realloc to %zu bytes lost the contents", i);
+      memset (p, i, i);
+    }
+  free (p);
+}
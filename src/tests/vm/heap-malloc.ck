@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) random allocations
+(heap-malloc) calloc
+(heap-malloc) realloc
+(heap-malloc) end
+heap-malloc: exit(0)
+EOF
+pass;
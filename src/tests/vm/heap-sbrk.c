@@ -0,0 +1,69 @@
+/* Grows the heap by 1 MB with sbrk(), fills it, and forks a child
+   that overwrites it.  Then shrinks the heap back, grows it again
+   and checks that the new pages read as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static void
+verify (const char *heap, size_t size, char value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (heap[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, heap[i], value);
+}
+
+void
+test_main (void)
+{
+  char *start, *heap;
+  pid_t child;
+
+  msg ("grow");
+  start = sbrk (0);
+  heap = sbrk (SIZE);
+  if (heap != start)
+    fail ("sbrk(%d) returned %p instead of %p", SIZE, heap, start);
+  if (sbrk (0) != start + SIZE)
+    fail ("break did not move");
+  memset (heap, 0x5a, SIZE);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: verify");
+      verify (heap, SIZE, 0x5a);
+      memset (heap, 0xa5, SIZE);
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork failed");
+  if (wait (child) != 81)
+    fail ("wrong exit code from child");
+
+  msg ("parent: verify");
+  verify (heap, SIZE, 0x5a);
+
+  msg ("shrink");
+  if (sbrk (-SIZE) != start + SIZE || sbrk (0) != start)
+    fail ("heap did not shrink");
+  if (sbrk (-1) != (void *) -1)
+    fail ("heap shrank below its start");
+
+  msg ("grow again");
+  heap = sbrk (SIZE);
+  if (heap != start)
+    fail ("sbrk(%d) returned %p instead of %p", SIZE, heap, start);
+  verify (heap, SIZE, 0);
+
+  msg ("grow too far");
+  if (sbrk (0x7fffffff) != (void *) -1)
+    fail ("heap grew into the stack");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap-sbrk) begin
+(heap-sbrk) grow
+(heap-sbrk) fork
+(heap-sbrk) child: verify
+heap-sbrk: exit(81)
+(heap-sbrk) parent: verify
+(heap-sbrk) shrink
+(heap-sbrk) grow again
+(heap-sbrk) grow too far
+(heap-sbrk) end
+heap-sbrk: exit(0)
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Maps 1 MB of private anonymous memory, checks that it reads as
+   zeros, fills it, and forks a child that overwrites it.  The
+   parent must not see the child's writes.  Then unmaps the region,
+   maps it again and checks that it reads as zeros once more. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define ADDR ((char *) 0x10000000)
+
+static void
+verify (const char *p, size_t size, char value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, p[i], value);
+}
+
+void
+test_main (void)
+{
+  mapid_t map;
+  pid_t child;
+
+  CHECK (mmap_anon (NULL, SIZE, MAP_PRIVATE) == MAP_FAILED,
+         "try to map at address 0");
+  CHECK (mmap_anon (ADDR + 1, SIZE, MAP_PRIVATE) == MAP_FAILED,
+         "try to map at misaligned address");
+  CHECK (mmap_anon (ADDR, SIZE, 2) == MAP_FAILED, "try bad flags");
+  CHECK (mmap_anon ((void *) 0xc0001000, 4096, MAP_PRIVATE) == MAP_FAILED,
+         "try to map kernel memory");
+  CHECK (mmap_anon ((void *) (0xc0000000 - 8 * 1024 * 1024 - 4096), 8192,
+                    MAP_PRIVATE) == MAP_FAILED,
+         "try to map into the stack's space");
+
+  CHECK ((map = mmap_anon (ADDR, SIZE, MAP_PRIVATE)) != MAP_FAILED,
+         "mmap_anon");
+  CHECK (mmap_anon (ADDR + SIZE / 2, SIZE, MAP_PRIVATE) == MAP_FAILED,
+         "try to map over the mapping");
+  msg ("verify zeros");
+  verify (ADDR, SIZE, 0);
+  memset (ADDR, 0x5a, SIZE);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: verify");
+      verify (ADDR, SIZE, 0x5a);
+      memset (ADDR, 0xa5, SIZE);
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork failed");
+  if (wait (child) != 81)
+    fail ("wrong exit code from child");
+
+  msg ("parent: verify");
+  verify (ADDR, SIZE, 0x5a);
+
+  munmap (map);
+  CHECK ((map = mmap_anon (ADDR, SIZE, MAP_PRIVATE)) != MAP_FAILED,
+         "mmap_anon again");
+  msg ("verify zeros");
+  verify (ADDR, SIZE, 0);
+  munmap (map);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) try to map at address 0
+(mmap-anon) try to map at misaligned address
+(mmap-anon) try bad flags
+(mmap-anon) try to map kernel memory
+(mmap-anon) try to map into the stack's space
+(mmap-anon) mmap_anon
+(mmap-anon) try to map over the mapping
+(mmap-anon) verify zeros
+(mmap-anon) fork
+(mmap-anon) child: verify
+mmap-anon: exit(81)
+(mmap-anon) parent: verify
+(mmap-anon) mmap_anon again
+(mmap-anon) verify zeros
+(mmap-anon) end
+mmap-anon: exit(0)
+EOF
+pass;
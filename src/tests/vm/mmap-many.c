@@ -0,0 +1,77 @@
+/* Maps hundreds of small files into consecutive regions of the
+   address space and then touches them in random order, so that
+   every access has to find the right memory area among many. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 256            /* Number of mapped files. */
+#define FILE_SIZE 512           /* Bytes in each file. */
+#define ACCESS_CNT 4096         /* Number of random accesses. */
+
+static char *base = (char *) 0x10000000;
+
+/* Expected content of byte OFS in file IDX. */
+static char
+expected_byte (size_t idx, size_t ofs)
+{
+  return (char) (idx * 31 + ofs);
+}
+
+/* Each file gets its own page, with a hole after it. */
+static char *
+file_addr (size_t idx)
+{
+  return base + idx * 2 * 4096;
+}
+
+void
+test_main (void)
+{
+  static char buf[FILE_SIZE];
+  mapid_t maps[FILE_CNT];
+  size_t i, j;
+
+  msg ("create and map %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char name[16];
+      int handle;
+
+      snprintf (name, sizeof name, "m%zu", i);
+      for (j = 0; j < FILE_SIZE; j++)
+        buf[j] = expected_byte (i, j);
+
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+      if ((handle = open (name)) < 2)
+        fail ("open \"%s\"", name);
+      if (write (handle, buf, FILE_SIZE) != FILE_SIZE)
+        fail ("write \"%s\"", name);
+      if ((maps[i] = mmap (handle, file_addr (i))) == MAP_FAILED)
+        fail ("mmap \"%s\"", name);
+      close (handle);
+    }
+
+  msg ("random access");
+  random_init (0x1234);
+  for (i = 0; i < ACCESS_CNT; i++)
+    {
+      size_t idx = random_ulong () % FILE_CNT;
+      size_t ofs = random_ulong () % 4096;
+      char want = ofs < FILE_SIZE ? expected_byte (idx, ofs) : 0;
+      char got = file_addr (idx)[ofs];
+
+      if (got != want)
+        fail ("byte %zu of file %zu is %02hhx (should be %02hhx)",
+              ofs, idx, got, want);
+    }
+
+  msg ("unmap");
+  for (i = 0; i < FILE_CNT; i++)
+    munmap (maps[i]);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-many) begin
+(mmap-many) create and map 256 files
+(mmap-many) random access
+(mmap-many) unmap
+(mmap-many) end
+EOF
+pass;
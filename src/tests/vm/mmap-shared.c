@@ -0,0 +1,52 @@
+/* Maps 2 MB of shared anonymous memory, fills the first half and
+   forks a child that checks it and overwrites all of it.  The
+   parent must see the child's writes, both in pages it had written
+   and in pages only the child touched. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define ADDR ((char *) 0x10000000)
+
+static void
+verify (const char *p, size_t size, char value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, p[i], value);
+}
+
+void
+test_main (void)
+{
+  mapid_t map;
+  pid_t child;
+
+  CHECK ((map = mmap_anon (ADDR, SIZE, MAP_SHARED)) != MAP_FAILED,
+         "mmap_anon");
+  memset (ADDR, 0x5a, SIZE / 2);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: verify");
+      verify (ADDR, SIZE / 2, 0x5a);
+      verify (ADDR + SIZE / 2, SIZE / 2, 0);
+      memset (ADDR, 0xa5, SIZE);
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork failed");
+  if (wait (child) != 81)
+    fail ("wrong exit code from child");
+
+  msg ("parent: verify");
+  verify (ADDR, SIZE, 0xa5);
+  munmap (map);
+}
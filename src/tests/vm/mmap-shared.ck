@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) mmap_anon
+(mmap-shared) fork
+(mmap-shared) child: verify
+mmap-shared: exit(81)
+(mmap-shared) parent: verify
+(mmap-shared) end
+mmap-shared: exit(0)
+EOF
+pass;
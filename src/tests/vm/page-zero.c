@@ -0,0 +1,32 @@
+/* Reads through 4 MB of BSS, more than fits in the user pool, then
+   writes to a few pages of it and checks that the rest still reads
+   back as zeros. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define STRIDE (64 * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+
+  msg ("write every 64th page");
+  for (i = 0; i < SIZE; i += STRIDE)
+    memset (buf + i, 0x5a, 4096);
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (i % STRIDE < 4096 ? 0x5a : 0))
+      fail ("byte %zu has wrong value", i);
+}
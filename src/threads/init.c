@@ -20,7 +20,9 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/trace.h"
 #include "threads/thread.h"
 
 #ifdef USERPROG
@@ -50,7 +52,9 @@
 #ifdef VM
 
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/share.h"
 
 #endif
 
@@ -70,9 +74,12 @@ static const char *swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
-/*! -ul: Maximum number of pages to put into palloc's user pool. */
+/*! -ul: Maximum number of pages to give to user pages. */
 static size_t user_page_limit = SIZE_MAX;
 
+/*! -trace: Where to dump traced events, or NULL not to trace. */
+static const char *trace_output;
+
 static void bss_init(void);
 static void paging_init(void);
 
@@ -112,6 +119,9 @@ int main(void) {
     palloc_init(user_page_limit);
     malloc_init();
     paging_init();
+    profile_init();
+    if (trace_output != NULL)
+        trace_init(trace_output);
 
     /* Segmentation. */
 #ifdef USERPROG
@@ -143,8 +153,11 @@ int main(void) {
 #endif
 
 #ifdef VM
-    frame_init(user_page_limit);
+    vm_page_init();
+    frame_init();
+    vm_share_init();
     swap_init();
+    palloc_set_reclaim(vm_reclaim_page);
 #endif
 
     printf("Boot complete.\n");
@@ -168,14 +181,38 @@ static void bss_init(void) {
     memset(&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/*! Returns the feature flags that CPUID leaf 1 reports in EDX. */
+static uint32_t cpu_features(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+
+    asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    return edx;
+}
+
 /*! Populates the base page directory and page table with the
     kernel virtual mapping, and then sets up the CPU to use the
     new page directory.  Points init_page_dir to the page
-    directory it creates. */
+    directory it creates.
+
+    If the CPU supports it, each 4 MB of RAM is mapped by a single
+    large page, which takes one TLB entry instead of 1024 and
+    needs no page table.  The 4 MB that hold kernel text, which is
+    mapped read-only, and a partial 4 MB at the end of RAM are
+    mapped with page tables as before.
+
+    If the CPU supports global pages, every kernel mapping is marked
+    global.  The kernel half of the address space is the same in
+    every page directory, so its TLB entries can survive the CR3
+    load on a switch between processes. */
 static void paging_init(void) {
     uint32_t *pd, *pt;
     size_t page;
     extern char _start, _end_kernel_text;
+    uint32_t features = cpu_features();
+    bool pse = (features & (1 << 3)) != 0;
+    bool pge = (features & (1 << 13)) != 0;
+    uint32_t global = pge ? PTE_G : 0;
+    uint32_t cr4;
 
     pd = init_page_dir = palloc_get_page(PAL_ASSERT | PAL_ZERO);
     pt = NULL;
@@ -186,20 +223,38 @@ static void paging_init(void) {
         size_t pte_idx = pt_no(vaddr);
         bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+        if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages
+            && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text)) {
+            pd[pde_idx] = pde_create_large(vaddr, true) | global;
+            page += PTSPAN / PGSIZE - 1;
+            continue;
+        }
+
         if (pd[pde_idx] == 0) {
             pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
             pd[pde_idx] = pde_create(pt);
         }
 
-        pt[pte_idx] = pte_create_kernel(vaddr, !in_kernel_text);
+        pt[pte_idx] = pte_create_kernel(vaddr, !in_kernel_text) | global;
     }
 
     /* Store the physical address of the page directory into CR3
        aka PDBR (page directory base register).  This activates our
        new page tables immediately.  See [IA32-v2a] "MOV--Move
        to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
-       of the Page Directory". */
+       of the Page Directory".  Large pages must be enabled in CR4
+       first; global pages are enabled only once the loader's
+       mappings are gone from the TLB. */
+    asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+    if (pse) {
+        cr4 |= CR4_PSE;
+        asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+    }
     asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+    if (pge) {
+        cr4 |= CR4_PGE;
+        asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+    }
 }
 
 /*! Breaks the kernel command line into words and returns them as
@@ -264,9 +319,27 @@ static char ** parse_options(char **argv) {
             random_init(atoi(value));
         else if (!strcmp(name, "-mlfqs"))
             thread_mlfqs = true;
+        else if (!strcmp(name, "-cpus")) {
+            int cpu_cnt = atoi(value);
+            if (cpu_cnt < 1 || cpu_cnt > THREAD_CPU_MAX)
+                PANIC("-cpus must be between 1 and %d", THREAD_CPU_MAX);
+            thread_cpu_cnt = cpu_cnt;
+        }
+        else if (!strcmp(name, "-tickless"))
+            timer_tickless = true;
+        else if (!strcmp(name, "-lockstat"))
+            lock_stat_enabled = true;
+        else if (!strcmp(name, "-profile"))
+            profile_enabled = true;
+        else if (!strcmp(name, "-trace"))
+            trace_output = value != NULL ? value : "console";
 #ifdef USERPROG
         else if (!strcmp(name, "-ul"))
             user_page_limit = atoi(value);
+#endif
+#ifdef VM
+        else if (!strcmp(name, "-fa"))
+            vm_fault_around_pages = atoi(value);
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
@@ -381,8 +454,16 @@ static void usage(void) {
 #endif
            "  -rs=SEED           Set random number seed to SEED.\n"
            "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+           "  -cpus=N            Schedule N CPUs, each with its own run queue.\n"
+           "  -tickless          Stop the periodic timer tick while idle.\n"
+           "  -lockstat          Keep lock contention statistics.\n"
+           "  -profile           Sample the running code on each timer tick.\n"
+           "  -trace[=scratch]   Trace kernel events, dump to console or scratch.\n"
 #ifdef USERPROG
            "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+           "  -fa=COUNT          Map up to COUNT file pages per page fault.\n"
 #endif
           );
     shutdown_power_off();
@@ -23,7 +23,18 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor, every thread keeps a "magazine",
+   a small stack of free blocks of that size that only it uses.
+   malloc() pops a block from the running thread's magazine and
+   free() pushes one onto it, with interrupts briefly disabled
+   but without taking the descriptor's lock.  When a thread's
+   magazine runs empty (or full), the thread trades it under the
+   lock for a full (or empty) one from the descriptor's "depot".
+   The depot holds a bounded number of magazines; a full magazine
+   that does not fit is emptied back into its arenas.  A thread's
+   magazines go back to the depot when it exits. */
 
 #include "threads/malloc.h"
 #include <debug.h>
@@ -32,10 +43,25 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
+/*! Number of blocks a magazine holds. */
+#define MAG_ROUNDS 15
+
+/*! Most full or empty magazines a depot keeps. */
+#define DEPOT_MAX 8
+
+/*! Magazine. */
+struct magazine {
+    struct list_elem elem;      /*!< Element in a depot list. */
+    size_t rounds;              /*!< Number of blocks held. */
+    void *round[MAG_ROUNDS];    /*!< Free blocks. */
+};
 
 /*! Descriptor. */
 struct desc {
@@ -43,6 +69,18 @@ struct desc {
     size_t blocks_per_arena;    /*!< Number of blocks in an arena. */
     struct list free_list;      /*!< List of free blocks. */
     struct lock lock;           /*!< Lock. */
+
+    /* Depot, protected by LOCK. */
+    struct list full_mags;      /*!< Full magazines. */
+    struct list empty_mags;     /*!< Empty magazines. */
+    size_t full_cnt;            /*!< Length of FULL_MAGS. */
+    size_t empty_cnt;           /*!< Length of EMPTY_MAGS. */
+
+    /* Statistics. */
+    unsigned long long fast_alloc_cnt;  /*!< Allocations from a magazine. */
+    unsigned long long slow_alloc_cnt;  /*!< Other allocations. */
+    unsigned long long fast_free_cnt;   /*!< Frees into a magazine. */
+    unsigned long long slow_free_cnt;   /*!< Other frees. */
 };
 
 /*! Magic number for detecting arena corruption. */
@@ -61,11 +99,16 @@ struct block {
 };
 
 /*! Our set of descriptors. */
-static struct desc descs[10];   /*!< Descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT];   /*!< Descriptors. */
 static size_t desc_cnt;         /*!< Number of descriptors. */
 
+/*! Cache of magazines. */
+static struct kmem_cache *mag_cache;
+
 static struct arena *block_to_arena(struct block *);
 static struct block *arena_to_block(struct arena *, size_t idx);
+static void arena_free(struct desc *, struct block *);
+static void depot_put(struct desc *, struct magazine *);
 
 /*! Initializes the malloc() descriptors. */
 void malloc_init(void) {
@@ -78,6 +121,29 @@ void malloc_init(void) {
         d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
         list_init(&d->free_list);
         lock_init(&d->lock);
+        list_init(&d->full_mags);
+        list_init(&d->empty_mags);
+    }
+    ASSERT(desc_cnt == MALLOC_CLASS_CNT);
+
+    mag_cache = kmem_cache_create("malloc_magazine",
+                                  sizeof (struct magazine), NULL);
+}
+
+/*! Returns the running thread's magazines to the depots.  Called
+    by a thread that is exiting, after its last call to free(). */
+void malloc_thread_exit(void) {
+    struct thread *cur = thread_current();
+    struct desc *d;
+
+    for (d = descs; d < descs + desc_cnt; d++) {
+        struct magazine **mp = &cur->mags[d - descs];
+        if (*mp != NULL) {
+            lock_acquire(&d->lock);
+            depot_put(d, *mp);
+            *mp = NULL;
+            lock_release(&d->lock);
+        }
     }
 }
 
@@ -87,6 +153,9 @@ void * malloc(size_t size) {
     struct desc *d;
     struct block *b;
     struct arena *a;
+    struct magazine *m, *full;
+    struct magazine **mp;
+    enum intr_level old_level;
 
     /* A null pointer satisfies a request for 0 bytes. */
     if (size == 0)
@@ -115,7 +184,38 @@ void * malloc(size_t size) {
         return a + 1;
     }
 
+    /* Take a block from our magazine, if it has any. */
+    mp = &thread_current()->mags[d - descs];
+    old_level = intr_disable();
+    m = *mp;
+    if (m != NULL && m->rounds > 0) {
+        b = m->round[--m->rounds];
+        d->fast_alloc_cnt++;
+        intr_set_level(old_level);
+        return b;
+    }
+    intr_set_level(old_level);
+
     lock_acquire(&d->lock);
+    d->slow_alloc_cnt++;
+
+    /* Trade our magazine for a full one from the depot. */
+    if (!list_empty(&d->full_mags)) {
+        full = list_entry(list_pop_front(&d->full_mags),
+                          struct magazine, elem);
+        d->full_cnt--;
+
+        old_level = intr_disable();
+        m = *mp;
+        *mp = full;
+        b = full->round[--full->rounds];
+        intr_set_level(old_level);
+
+        if (m != NULL)
+            depot_put(d, m);
+        lock_release(&d->lock);
+        return b;
+    }
 
     /* If the free list is empty, create a new arena. */
     if (list_empty (&d->free_list)) {
@@ -166,7 +266,7 @@ void * calloc(size_t a, size_t b) {
 }
 
 /*! Returns the number of bytes allocated for BLOCK. */
-static size_t block_size(void *block) {
+static size_t allocated_size(void *block) {
     struct block *b = block;
     struct arena *a = block_to_arena(b);
     struct desc *d = a->desc;
@@ -190,7 +290,7 @@ void * realloc(void *old_block, size_t new_size) {
     else {
         void *new_block = malloc(new_size);
         if (old_block != NULL && new_block != NULL) {
-            size_t old_size = block_size (old_block);
+            size_t old_size = allocated_size (old_block);
             size_t min_size = new_size < old_size ? new_size : old_size;
             memcpy(new_block, old_block, min_size);
             free(old_block);
@@ -209,28 +309,54 @@ void free(void *p) {
 
         if (d != NULL) {
             /* It's a normal block.  We handle it here. */
+            struct magazine *m, *empty;
+            struct magazine **mp = &thread_current()->mags[d - descs];
+            enum intr_level old_level;
 
 #ifndef NDEBUG
             /* Clear the block to help detect use-after-free bugs. */
             memset(b, 0xcc, d->block_size);
 #endif
 
-            lock_acquire(&d->lock);
+            /* Put the block in our magazine, if it has room. */
+            old_level = intr_disable();
+            m = *mp;
+            if (m != NULL && m->rounds < MAG_ROUNDS) {
+                m->round[m->rounds++] = b;
+                d->fast_free_cnt++;
+                intr_set_level(old_level);
+                return;
+            }
+            intr_set_level(old_level);
 
-            /* Add block to free list. */
-            list_push_front(&d->free_list, &b->free_elem);
+            lock_acquire(&d->lock);
+            d->slow_free_cnt++;
+
+            /* Trade our magazine for an empty one from the depot,
+               or a new one. */
+            if (!list_empty(&d->empty_mags)) {
+                empty = list_entry(list_pop_front(&d->empty_mags),
+                                   struct magazine, elem);
+                d->empty_cnt--;
+            }
+            else {
+                empty = kmem_cache_alloc(mag_cache);
+                if (empty != NULL)
+                    empty->rounds = 0;
+            }
 
-            /* If the arena is now entirely unused, free it. */
-            if (++a->free_cnt >= d->blocks_per_arena) {
-                size_t i;
+            if (empty != NULL) {
+                old_level = intr_disable();
+                m = *mp;
+                *mp = empty;
+                empty->round[empty->rounds++] = b;
+                intr_set_level(old_level);
 
-                ASSERT(a->free_cnt == d->blocks_per_arena);
-                for (i = 0; i < d->blocks_per_arena; i++) {
-                    struct block *b = arena_to_block(a, i);
-                    list_remove(&b->free_elem);
-                }
-                palloc_free_page(a);
+                if (m != NULL)
+                    depot_put(d, m);
             }
+            else
+                arena_free(d, b);
 
             lock_release(&d->lock);
         }
@@ -242,6 +368,69 @@ void free(void *p) {
     }
 }
 
+/*! Prints magazine statistics for each descriptor that has been
+    used. */
+void malloc_print_stats(void) {
+    struct desc *d;
+
+    for (d = descs; d < descs + desc_cnt; d++)
+        if (d->fast_alloc_cnt + d->slow_alloc_cnt > 0)
+            printf("Malloc %zu-byte blocks: %llu fast, %llu slow allocations; "
+                   "%llu fast, %llu slow frees; %zu full, %zu empty "
+                   "magazines in depot\n",
+                   d->block_size, d->fast_alloc_cnt, d->slow_alloc_cnt,
+                   d->fast_free_cnt, d->slow_free_cnt,
+                   d->full_cnt, d->empty_cnt);
+}
+
+/*! Returns block B to its arena in descriptor D, giving the arena
+    back to the page allocator if it is now entirely unused.  D's
+    lock must be held. */
+static void arena_free(struct desc *d, struct block *b) {
+    struct arena *a = block_to_arena(b);
+
+    ASSERT(lock_held_by_current_thread(&d->lock));
+
+    /* Add block to free list. */
+    list_push_front(&d->free_list, &b->free_elem);
+
+    /* If the arena is now entirely unused, free it. */
+    if (++a->free_cnt >= d->blocks_per_arena) {
+        size_t i;
+
+        ASSERT(a->free_cnt == d->blocks_per_arena);
+        for (i = 0; i < d->blocks_per_arena; i++) {
+            struct block *b = arena_to_block(a, i);
+            list_remove(&b->free_elem);
+        }
+        palloc_free_page(a);
+    }
+}
+
+/*! Puts magazine M, which no thread owns any more, into the depot
+    of descriptor D.  A full magazine is kept as is if the depot
+    has room for it; otherwise its blocks go back to their arenas
+    and it is kept as an empty magazine, or freed.  D's lock must
+    be held. */
+static void depot_put(struct desc *d, struct magazine *m) {
+    ASSERT(lock_held_by_current_thread(&d->lock));
+
+    if (m->rounds == MAG_ROUNDS && d->full_cnt < DEPOT_MAX) {
+        list_push_front(&d->full_mags, &m->elem);
+        d->full_cnt++;
+        return;
+    }
+
+    while (m->rounds > 0)
+        arena_free(d, m->round[--m->rounds]);
+    if (d->empty_cnt < DEPOT_MAX) {
+        list_push_front(&d->empty_mags, &m->elem);
+        d->empty_cnt++;
+    }
+    else
+        kmem_cache_free(mag_cache, m);
+}
+
 /*! Returns the arena that block B is inside. */
 static struct arena * block_to_arena(struct block *b) {
     struct arena *a = pg_round_down(b);
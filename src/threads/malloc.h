@@ -4,7 +4,15 @@
 #include <debug.h>
 #include <stddef.h>
 
+/*! Number of block sizes served from arenas, 16 through 1024 bytes. */
+#define MALLOC_CLASS_CNT 7
+
+/*! Per-thread stack of free blocks of one size, in malloc.c. */
+struct magazine;
+
 void malloc_init(void);
+void malloc_thread_exit(void);
+void malloc_print_stats(void);
 void *malloc(size_t) __attribute__ ((malloc));
 void *calloc(size_t, size_t) __attribute__ ((malloc));
 void *realloc(void *, size_t);
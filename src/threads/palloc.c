@@ -3,89 +3,178 @@
    Page allocator.  Hands out memory in page-size (or page-multiple) chunks.
    See malloc.h for an allocator that hands out smaller chunks.
 
-   System memory is divided into two "pools" called the kernel and user pools.
-   The user pool is for user (virtual) memory pages, the kernel pool for
-   everything else.  The idea here is that the kernel needs to have memory for
-   its own operations even if user processes are swapping like mad.
+   All free memory is in a single pool, shared by two classes of pages: user
+   pages, for user (virtual) memory, and kernel pages for everything else.
+   The idea here is that the kernel needs to have memory for its own
+   operations even if user processes are swapping like mad, without leaving
+   half of RAM idle when they are not.
 
-   By default, half of system RAM is given to the kernel pool and half to the
-   user pool.  That should be huge overkill for the kernel pool, but that's
-   just fine for demonstration purposes. */
+   Each class has a soft quota.  By default, half of system RAM is the quota
+   of each class; the user quota may be lowered with -ul, which also caps the
+   user class outright.  A class may always take free pages up to its quota.
+   Past its quota it borrows from the other class's unused quota, but only
+   while that leaves half of the unused quota free.
+
+   Pages the kernel lends to user processes are taken back under pressure.
+   When a kernel request within quota finds no free pages, the reclaim
+   function that the VM registers with palloc_set_reclaim() evicts user
+   pages through the frame table, and the request is retried, for as long
+   as the user class is past its quota.
+
+   The pool is a binary buddy allocator.  Free memory is kept as blocks of
+   2**ORDER pages, aligned to their size relative to the start of the pool,
+   on one free list per order.  A request for N pages takes a block of the
+   smallest order that fits, splitting a larger block if need be, and hands
+   the pages past N back as smaller blocks.  A freed block is merged with its
+   buddy (the other half of the block of the next order) for as long as the
+   buddy is free too, so both allocation and freeing take O(log n) steps.
+
+   A byte per page, kept at the start of the pool, records whether the page
+   is free and, for the first page of a free block, the block's order.  The
+   free list elements live in the free pages themselves.
+
+   The idle thread zeroes single free pages in the background and keeps them
+   on a separate list, so that a PAL_ZERO request for one page
+   can usually be served without touching memory.  Pre-zeroed pages count as
+   free; they go back to the buddy lists when a request cannot otherwise be
+   met. */
 
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
+/*! Largest block order: blocks of up to 2**PALLOC_MAX_ORDER pages. */
+#define PALLOC_MAX_ORDER 20
+
+/*! Page map entries. */
+#define PAGE_USED 0x00                  /*!< Allocated page. */
+#define PAGE_USER 0x20                  /*!< Allocated user page. */
+#define PAGE_FREE 0x40                  /*!< Page in a free block. */
+#define PAGE_HEAD 0x80                  /*!< First page of a free block. */
+#define PAGE_ORDER 0x3f                 /*!< Mask for the order of a head. */
+
+/*! Most pre-zeroed pages kept. */
+#define PALLOC_ZERO_MAX 256
+
 /*! A memory pool. */
 struct pool {
-    struct lock lock;                   /*!< Mutual exclusion. */
-    struct bitmap *used_map;            /*!< Bitmap of free pages. */
+    const char *name;                   /*!< Name, for statistics. */
+    uint8_t *page_map;                  /*!< One entry per page. */
     uint8_t *base;                      /*!< Base of pool. */
+    size_t page_cnt;                    /*!< Number of pages in pool. */
+    size_t free_cnt;                    /*!< Number of free pages. */
+    struct list free[PALLOC_MAX_ORDER + 1];  /*!< Free blocks by order. */
+    size_t block_cnt[PALLOC_MAX_ORDER + 1];  /*!< Length of each list. */
+    struct list zeroed;                 /*!< Pre-zeroed free pages. */
+    size_t zeroed_cnt;                  /*!< Length of ZEROED. */
+
+    /* Statistics. */
+    unsigned long long split_cnt;       /*!< Blocks split in two. */
+    unsigned long long merge_cnt;       /*!< Blocks merged with buddy. */
+    unsigned long long zero_hit_cnt;    /*!< PAL_ZERO pages pre-zeroed. */
+    unsigned long long zero_miss_cnt;   /*!< PAL_ZERO pages zeroed late. */
+};
+
+/*! The pool of all free memory. */
+static struct pool ram_pool;
+
+/*! A class of pages. */
+struct page_class {
+    const char *name;                   /*!< Name, for statistics. */
+    size_t quota;                       /*!< Pages it may always take. */
+    size_t limit;                       /*!< Pages it may never exceed. */
+    size_t used;                        /*!< Pages allocated. */
+
+    /* Statistics. */
+    size_t max_used;                    /*!< Most pages allocated at once. */
+    unsigned long long alloc_cnt;       /*!< Successful allocations. */
+    unsigned long long fail_cnt;        /*!< Failed allocations. */
+    unsigned long long borrow_cnt;      /*!< Allocations past quota. */
+    unsigned long long reclaim_cnt;     /*!< Pages taken back from it. */
 };
 
-/*! Two pools: one for kernel data, one for user pages. */
-static struct pool kernel_pool, user_pool;
+/*! Classes of pages, indexed by whether PAL_USER is set. */
+enum { KERNEL_CLASS, USER_CLASS };
+static struct page_class classes[2];
+
+/*! Frees a user page for the kernel, or NULL before the VM is up. */
+static palloc_reclaim_func *reclaim_func;
 
 static void init_pool(struct pool *, void *base, size_t page_cnt,
                       const char *name);
+static void *get_pages(struct page_class *, enum palloc_flags,
+                       size_t page_cnt);
+static bool class_may_take(const struct page_class *, size_t page_cnt);
+static bool may_reclaim(const struct page_class *, size_t page_cnt);
 static bool page_from_pool(const struct pool *, void *page);
+static size_t alloc_block(struct pool *, int order);
+static void free_block(struct pool *, size_t page_idx, int order);
+static void free_range(struct pool *, size_t page_idx, size_t page_cnt);
+static bool release_zeroed(struct pool *);
+static bool zero_page(struct pool *);
+static void print_pool_stats(const struct pool *);
+static void print_class_stats(const struct page_class *);
 
 /*! Initializes the page allocator.  At most USER_PAGE_LIMIT
-    pages are put into the user pool. */
+    pages are given to user pages. */
 void palloc_init(size_t user_page_limit) {
     /* Free memory starts at 1 MB and runs to the end of RAM. */
     uint8_t *free_start = ptov(1024 * 1024);
     uint8_t *free_end = ptov(init_ram_pages * PGSIZE);
     size_t free_pages = (free_end - free_start) / PGSIZE;
-    size_t user_pages = free_pages / 2;
-    size_t kernel_pages;
-    if (user_pages > user_page_limit)
-        user_pages = user_page_limit;
-    kernel_pages = free_pages - user_pages;
+    size_t user_pages;
+
+    init_pool(&ram_pool, free_start, free_pages, "RAM pool");
 
     /* Give half of memory to kernel, half to user. */
-    init_pool(&kernel_pool, free_start, kernel_pages, "kernel pool");
-    init_pool(&user_pool, free_start + kernel_pages * PGSIZE,
-              user_pages, "user pool");
+    user_pages = ram_pool.page_cnt / 2;
+    if (user_pages > user_page_limit)
+        user_pages = user_page_limit;
+    classes[KERNEL_CLASS].name = "kernel";
+    classes[KERNEL_CLASS].quota = ram_pool.page_cnt - user_pages;
+    classes[KERNEL_CLASS].limit = ram_pool.page_cnt;
+    classes[USER_CLASS].name = "user";
+    classes[USER_CLASS].quota = user_pages;
+    classes[USER_CLASS].limit = (user_page_limit < ram_pool.page_cnt
+                                 ? user_page_limit : ram_pool.page_cnt);
+    printf("%zu pages quota for kernel, %zu for user.\n",
+           classes[KERNEL_CLASS].quota, classes[USER_CLASS].quota);
 }
 
 /*! Obtains and returns a group of PAGE_CNT contiguous free pages.
-    If PAL_USER is set, the pages are obtained from the user pool,
-    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-    then the pages are filled with zeros.  If too few pages are
-    available, returns a null pointer, unless PAL_ASSERT is set in
-    FLAGS, in which case the kernel panics. */
+    If PAL_USER is set, the pages are user pages, otherwise kernel
+    pages.  If PAL_ZERO is set in FLAGS, then the pages are filled
+    with zeros.  If too few pages are available to the class,
+    returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
+    which case the kernel panics. */
 void * palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
-    struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    struct page_class *c = &classes[flags & PAL_USER ? USER_CLASS
+                                                      : KERNEL_CLASS];
+    enum intr_level old_level;
     void *pages;
-    size_t page_idx;
 
     if (page_cnt == 0)
         return NULL;
 
-    lock_acquire(&pool->lock);
-    page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
-    lock_release(&pool->lock);
-
-    if (page_idx != BITMAP_ERROR)
-        pages = pool->base + PGSIZE * page_idx;
-    else
-        pages = NULL;
+    /* Take back pages lent to user processes, one at a time, until the
+       request fits or there are none left to take. */
+    while ((pages = get_pages(c, flags, page_cnt)) == NULL
+           && may_reclaim(c, page_cnt) && reclaim_func())
+        classes[USER_CLASS].reclaim_cnt++;
 
-    if (pages != NULL) {
-        if (flags & PAL_ZERO)
-            memset(pages, 0, PGSIZE * page_cnt);
-    }
-    else {
+    if (pages == NULL) {
+        old_level = intr_disable();
+        c->fail_cnt++;
+        intr_set_level(old_level);
         if (flags & PAL_ASSERT)
             PANIC("palloc_get: out of pages");
     }
@@ -95,39 +184,44 @@ void * palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
 
 /*! Obtains a single free page and returns its kernel virtual
     address.
-    If PAL_USER is set, the page is obtained from the user pool,
-    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-    then the page is filled with zeros.  If no pages are
-    available, returns a null pointer, unless PAL_ASSERT is set in
-    FLAGS, in which case the kernel panics. */
+    If PAL_USER is set, the page is a user page, otherwise a
+    kernel page.  If PAL_ZERO is set in FLAGS, then the page is
+    filled with zeros.  If no pages are available to the class,
+    returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
+    which case the kernel panics. */
 void * palloc_get_page(enum palloc_flags flags) {
     return palloc_get_multiple(flags, 1);
 }
 
 /*! Frees the PAGE_CNT pages starting at PAGES. */
 void palloc_free_multiple(void *pages, size_t page_cnt) {
-    struct pool *pool;
+    struct pool *pool = &ram_pool;
+    struct page_class *c;
+    enum intr_level old_level;
     size_t page_idx;
 
     ASSERT(pg_ofs(pages) == 0);
     if (pages == NULL || page_cnt == 0)
         return;
 
-    if (page_from_pool(&kernel_pool, pages))
-        pool = &kernel_pool;
-    else if (page_from_pool(&user_pool, pages))
-        pool = &user_pool;
-    else
+    if (!page_from_pool(pool, pages))
         NOT_REACHED();
 
     page_idx = pg_no(pages) - pg_no(pool->base);
+    ASSERT(page_idx + page_cnt <= pool->page_cnt);
+    c = &classes[pool->page_map[page_idx] & PAGE_USER ? USER_CLASS
+                                                     : KERNEL_CLASS];
 
 #ifndef NDEBUG
     memset(pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-    ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
-    bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    old_level = intr_disable();
+    ASSERT(c->used >= page_cnt);
+    c->used -= page_cnt;
+    free_range(pool, page_idx, page_cnt);
+    pool->free_cnt += page_cnt;
+    intr_set_level(old_level);
 }
 
 /*! Frees the page at PAGE. */
@@ -135,32 +229,331 @@ void palloc_free_page(void *page) {
     palloc_free_multiple(page, 1);
 }
 
+/*! Registers FUNC as the function that frees a user page when a
+    kernel request within quota finds no free pages.  FUNC returns
+    false if it could not free one.  It is called with interrupts on
+    and must not wait for anything the caller of palloc_get_page()
+    may hold. */
+void palloc_set_reclaim(palloc_reclaim_func *func) {
+    reclaim_func = func;
+}
+
+/*! Returns the most pages that the class selected by PAL_USER in
+    FLAGS can ever hold at once. */
+size_t palloc_page_limit(enum palloc_flags flags) {
+    return classes[flags & PAL_USER ? USER_CLASS : KERNEL_CLASS].limit;
+}
+
+/*! Zeroes one free page in the background and sets it aside for
+    PAL_ZERO requests.  Returns false if as many pre-zeroed pages
+    as are kept are ready, or there are no other free pages.
+    Called by the idle thread. */
+bool palloc_zero_idle(void) {
+    return zero_page(&ram_pool);
+}
+
+/*! Prints free memory and fragmentation statistics for the pool
+    and usage of each class. */
+void palloc_print_stats(void) {
+    print_pool_stats(&ram_pool);
+    print_class_stats(&classes[KERNEL_CLASS]);
+    print_class_stats(&classes[USER_CLASS]);
+}
+
 /*! Initializes pool P as starting at START and ending at END,
     naming it NAME for debugging purposes. */
 static void init_pool(struct pool *p, void *base, size_t page_cnt,
                       const char *name) {
-    /* We'll put the pool's used_map at its base.
-       Calculate the space needed for the bitmap
+    /* We'll put the pool's page map at its base.
+       Calculate the space needed for the map
        and subtract it from the pool's size. */
-    size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(page_cnt), PGSIZE);
-    if (bm_pages > page_cnt)
-        PANIC("Not enough memory in %s for bitmap.", name);
-    page_cnt -= bm_pages;
+    size_t map_pages = DIV_ROUND_UP(page_cnt, PGSIZE);
+    int order;
+    if (map_pages > page_cnt)
+        PANIC("Not enough memory in %s for page map.", name);
+    page_cnt -= map_pages;
 
     printf("%zu pages available in %s.\n", page_cnt, name);
 
     /* Initialize the pool. */
-    lock_init(&p->lock);
-    p->used_map = bitmap_create_in_buf(page_cnt, base, bm_pages * PGSIZE);
-    p->base = base + bm_pages * PGSIZE;
+    p->name = name;
+    p->page_map = base;
+    p->base = base + map_pages * PGSIZE;
+    p->page_cnt = page_cnt;
+    p->free_cnt = page_cnt;
+    for (order = 0; order <= PALLOC_MAX_ORDER; order++) {
+        list_init(&p->free[order]);
+        p->block_cnt[order] = 0;
+    }
+    list_init(&p->zeroed);
+    p->zeroed_cnt = 0;
+    free_range(p, 0, page_cnt);
+}
+
+/*! Takes PAGE_CNT contiguous free pages for class C, zeroed if
+    PAL_ZERO is set in FLAGS.  Returns a null pointer if the class
+    may not take that many or they are not free. */
+static void *get_pages(struct page_class *c, enum palloc_flags flags,
+                       size_t page_cnt) {
+    struct pool *pool = &ram_pool;
+    enum intr_level old_level;
+    void *pages;
+    size_t page_idx;
+    int order;
+
+    /* Smallest block that holds PAGE_CNT pages. */
+    for (order = 0; order <= PALLOC_MAX_ORDER; order++)
+        if ((size_t) 1 << order >= page_cnt)
+            break;
+
+    /* The pool is updated with interrupts off rather than under a
+       lock because thread_schedule_tail() frees the page of a dying
+       thread from inside the scheduler. */
+    old_level = intr_disable();
+    if (!class_may_take(c, page_cnt))
+        page_idx = SIZE_MAX;
+    else if (page_cnt == 1 && (flags & PAL_ZERO)
+             && !list_empty(&pool->zeroed)) {
+        /* A page the idle thread has already zeroed. */
+        pages = list_pop_front(&pool->zeroed);
+        memset(pages, 0, sizeof (struct list_elem));
+        pool->zeroed_cnt--;
+        pool->zero_hit_cnt++;
+        page_idx = pg_no(pages) - pg_no(pool->base);
+        flags &= ~PAL_ZERO;
+    }
+    else
+        do
+            page_idx = (order <= PALLOC_MAX_ORDER
+                        ? alloc_block(pool, order) : SIZE_MAX);
+        while (page_idx == SIZE_MAX && release_zeroed(pool));
+
+    if (page_idx != SIZE_MAX) {
+        /* Give back the pages past the end of the request. */
+        if (page_cnt < (size_t) 1 << order)
+            free_range(pool, page_idx + page_cnt,
+                       ((size_t) 1 << order) - page_cnt);
+        if (c == &classes[USER_CLASS])
+            memset(pool->page_map + page_idx, PAGE_USER, page_cnt);
+        pool->free_cnt -= page_cnt;
+        if (c->used + page_cnt > c->quota)
+            c->borrow_cnt++;
+        c->used += page_cnt;
+        if (c->used > c->max_used)
+            c->max_used = c->used;
+        c->alloc_cnt++;
+    }
+    intr_set_level(old_level);
+
+    if (page_idx == SIZE_MAX)
+        return NULL;
+
+    pages = pool->base + PGSIZE * page_idx;
+    if (flags & PAL_ZERO) {
+        memset(pages, 0, PGSIZE * page_cnt);
+        pool->zero_miss_cnt += page_cnt;
+    }
+    return pages;
+}
+
+/*! Returns true if class C may take PAGE_CNT more pages: always
+    within its quota, and past it, up to its limit, while at least
+    half of the other class's unused quota stays free.  Does not
+    check that the pages are actually free. */
+static bool class_may_take(const struct page_class *c, size_t page_cnt) {
+    const struct page_class *other = &classes[c == &classes[USER_CLASS]
+                                              ? KERNEL_CLASS : USER_CLASS];
+    size_t reserve;
+
+    if (c->used + page_cnt > c->limit)
+        return false;
+    if (c->used + page_cnt <= c->quota)
+        return true;
+
+    reserve = other->used < other->quota ? (other->quota - other->used) / 2 : 0;
+    return ram_pool.free_cnt >= page_cnt + reserve;
+}
+
+/*! Returns true if a failed request of class C for PAGE_CNT pages
+    should take back a page lent to user processes and try again:
+    the request is the kernel's, within its quota, the user class is
+    past its own, and reclaim_func can be called from here. */
+static bool may_reclaim(const struct page_class *c, size_t page_cnt) {
+    const struct page_class *user = &classes[USER_CLASS];
+
+    return (reclaim_func != NULL && c == &classes[KERNEL_CLASS]
+            && c->used + page_cnt <= c->quota && user->used > user->quota
+            && !intr_context() && intr_get_level() == INTR_ON);
 }
 
 /*! Returns true if PAGE was allocated from POOL, false otherwise. */
 static bool page_from_pool(const struct pool *pool, void *page) {
     size_t page_no = pg_no(page);
     size_t start_page = pg_no(pool->base);
-    size_t end_page = start_page + bitmap_size(pool->used_map);
+    size_t end_page = start_page + pool->page_cnt;
 
     return page_no >= start_page && page_no < end_page;
 }
 
+/*! Removes a free block of 2**ORDER pages from POOL, splitting a
+    larger block if necessary, marks its pages used and returns
+    the index of its first page.  Returns SIZE_MAX if POOL has no
+    block large enough. */
+static size_t alloc_block(struct pool *pool, int order) {
+    size_t page_idx;
+    int o;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    for (o = order; o <= PALLOC_MAX_ORDER; o++)
+        if (!list_empty(&pool->free[o]))
+            break;
+    if (o > PALLOC_MAX_ORDER)
+        return SIZE_MAX;
+
+    page_idx = pg_no(list_pop_front(&pool->free[o])) - pg_no(pool->base);
+    pool->block_cnt[o]--;
+    ASSERT(pool->page_map[page_idx] == (PAGE_HEAD | PAGE_FREE | o));
+
+    /* Split, keeping the lower half each time. */
+    while (o > order) {
+        size_t buddy_idx;
+
+        o--;
+        buddy_idx = page_idx + ((size_t) 1 << o);
+        pool->page_map[buddy_idx] = PAGE_HEAD | PAGE_FREE | o;
+        list_push_front(&pool->free[o],
+                        (struct list_elem *) (pool->base + PGSIZE * buddy_idx));
+        pool->block_cnt[o]++;
+        pool->split_cnt++;
+    }
+
+    memset(pool->page_map + page_idx, PAGE_USED, (size_t) 1 << order);
+    return page_idx;
+}
+
+/*! Returns the block of 2**ORDER pages that starts at PAGE_IDX in
+    POOL to its free lists, merging it with its buddy for as long
+    as the buddy is free. */
+static void free_block(struct pool *pool, size_t page_idx, int order) {
+    size_t i;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(page_idx % ((size_t) 1 << order) == 0);
+
+    for (i = 0; i < (size_t) 1 << order; i++) {
+        ASSERT(!(pool->page_map[page_idx + i] & PAGE_FREE));
+        pool->page_map[page_idx + i] = PAGE_FREE;
+    }
+
+    while (order < PALLOC_MAX_ORDER) {
+        size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+
+        if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+            || pool->page_map[buddy_idx] != (PAGE_HEAD | PAGE_FREE | order))
+            break;
+
+        list_remove((struct list_elem *) (pool->base + PGSIZE * buddy_idx));
+        pool->block_cnt[order]--;
+        pool->page_map[buddy_idx] = PAGE_FREE;
+        pool->merge_cnt++;
+
+        page_idx &= ~((size_t) 1 << order);
+        order++;
+    }
+
+    pool->page_map[page_idx] = PAGE_HEAD | PAGE_FREE | order;
+    list_push_front(&pool->free[order],
+                    (struct list_elem *) (pool->base + PGSIZE * page_idx));
+    pool->block_cnt[order]++;
+}
+
+/*! Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+    largest aligned blocks that cover them. */
+static void free_range(struct pool *pool, size_t page_idx, size_t page_cnt) {
+    while (page_cnt > 0) {
+        int order = 0;
+
+        while (order < PALLOC_MAX_ORDER
+               && page_idx % ((size_t) 2 << order) == 0
+               && (size_t) 2 << order <= page_cnt)
+            order++;
+
+        free_block(pool, page_idx, order);
+        page_idx += (size_t) 1 << order;
+        page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/*! Returns POOL's pre-zeroed pages to its buddy lists.  Returns
+    false if it had none. */
+static bool release_zeroed(struct pool *pool) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (list_empty(&pool->zeroed))
+        return false;
+    while (!list_empty(&pool->zeroed)) {
+        void *page = list_pop_front(&pool->zeroed);
+        free_block(pool, pg_no(page) - pg_no(pool->base), 0);
+    }
+    pool->zeroed_cnt = 0;
+    return true;
+}
+
+/*! Takes a free page from POOL, zeroes it with interrupts on and
+    adds it to POOL's pre-zeroed pages.  Returns false if POOL
+    already has enough of them or no other free page. */
+static bool zero_page(struct pool *pool) {
+    enum intr_level old_level;
+    size_t page_idx;
+    uint8_t *page;
+
+    old_level = intr_disable();
+    page_idx = (pool->zeroed_cnt < PALLOC_ZERO_MAX
+                ? alloc_block(pool, 0) : SIZE_MAX);
+    intr_set_level(old_level);
+    if (page_idx == SIZE_MAX)
+        return false;
+
+    page = pool->base + PGSIZE * page_idx;
+    memset(page, 0, PGSIZE);
+
+    /* The list element overwrites the first bytes of the page;
+       palloc_get_multiple() clears them again. */
+    old_level = intr_disable();
+    list_push_front(&pool->zeroed, (struct list_elem *) page);
+    pool->zeroed_cnt++;
+    intr_set_level(old_level);
+    return true;
+}
+
+/*! Prints statistics for POOL.  The number of free blocks of
+    each order shows how fragmented its free memory is. */
+static void print_pool_stats(const struct pool *pool) {
+    int order, largest = -1;
+
+    for (order = 0; order <= PALLOC_MAX_ORDER; order++)
+        if (pool->block_cnt[order] > 0)
+            largest = order;
+
+    printf("Palloc %s: %zu of %zu pages free, largest block %zu pages\n",
+           pool->name, pool->free_cnt, pool->page_cnt,
+           largest >= 0 ? (size_t) 1 << largest : 0);
+    printf("  %llu splits, %llu merges\n", pool->split_cnt, pool->merge_cnt);
+    printf("  %zu pages pre-zeroed, %llu zeroed pages ready when asked, "
+           "%llu zeroed on demand\n", pool->zeroed_cnt,
+           pool->zero_hit_cnt, pool->zero_miss_cnt);
+    printf("  free blocks by order:");
+    for (order = 0; order <= largest; order++)
+        printf(" %zu", pool->block_cnt[order]);
+    printf("\n");
+}
+
+/*! Prints usage statistics for class C. */
+static void print_class_stats(const struct page_class *c) {
+    printf("Palloc %s pages: %zu in use (max %zu), quota %zu, "
+           "%llu allocations, %llu past quota, %llu taken back, "
+           "%llu failures\n",
+           c->name, c->used, c->max_used, c->quota, c->alloc_cnt,
+           c->borrow_cnt, c->reclaim_cnt, c->fail_cnt);
+}
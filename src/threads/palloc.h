@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,17 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Frees a user page for the kernel.  Returns false if it cannot. */
+typedef bool palloc_reclaim_func (void);
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_set_reclaim (palloc_reclaim_func *);
+size_t palloc_page_limit (enum palloc_flags);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
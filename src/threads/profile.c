@@ -0,0 +1,134 @@
+/*! \file profile.c
+
+   Sampling profiler.  When the kernel is booted with -profile, every
+   timer interrupt records where the CPU was: the interrupted thread,
+   whether it was running user or kernel code, the interrupted EIP and,
+   for kernel code, the return addresses of a few enclosing frames.
+   Samples go into a ring buffer that keeps the most recent
+   PROFILE_SAMPLES of them, and are dumped at power-off.
+
+   The dump is meant for "backtrace --profile" or "backtrace --folded",
+   which symbolize it into a flat profile or into folded stacks.  Like
+   debug_backtrace(), the frame walk relies on the frame pointer chain,
+   so callers of functions compiled without one may be missed. */
+
+#include "threads/profile.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/*! Kernel frames recorded per sample, including the EIP. */
+#define PROFILE_DEPTH 6
+
+/*! One sample. */
+struct sample {
+    tid_t tid;                  /*!< Interrupted thread. */
+    uint8_t user;               /*!< Interrupted user code? */
+    uint8_t depth;              /*!< Number of entries in PC. */
+    uintptr_t pc[PROFILE_DEPTH]; /*!< EIP, then return addresses. */
+};
+
+/*! The ring buffer of samples. */
+#define PROFILE_PAGES 32
+#define PROFILE_SAMPLES (PROFILE_PAGES * PGSIZE / sizeof (struct sample))
+static struct sample *samples;
+static uint64_t sample_cnt;     /*!< Samples taken since boot. */
+
+/*! Names of the sampled threads, since they may have exited by the
+    time the samples are dumped. */
+#define PROFILE_THREADS 64
+struct sampled_thread {
+    tid_t tid;                  /*!< Thread identifier. */
+    char name[16];              /*!< Its name. */
+};
+static struct sampled_thread threads[PROFILE_THREADS];
+static size_t thread_cnt;
+
+/*! If true, sample the running code on every timer tick. */
+bool profile_enabled;
+
+static void remember_thread(const struct thread *);
+
+/*! Allocates the sample buffer, if -profile was given. */
+void profile_init(void) {
+    if (profile_enabled)
+        samples = palloc_get_multiple(PAL_ASSERT, PROFILE_PAGES);
+}
+
+/*! Records a sample of the code interrupted at F.  Called from the
+    timer interrupt handler. */
+void profile_sample(const struct intr_frame *f) {
+    struct thread *t = thread_current();
+    struct sample *s;
+
+    if (samples == NULL)
+        return;
+
+    s = &samples[sample_cnt++ % PROFILE_SAMPLES];
+    s->tid = t->tid;
+    s->user = (f->cs & 3) == 3;
+    s->pc[0] = (uintptr_t) f->eip;
+    s->depth = 1;
+
+    /* Follow saved frame pointers up the interrupted thread's kernel
+       stack, as long as they stay inside it and move toward its top. */
+    if (!s->user) {
+        uint32_t *frame = (uint32_t *) f->ebp;
+        uint8_t *stack_end = (uint8_t *) t + PGSIZE;
+
+        while (s->depth < PROFILE_DEPTH &&
+               pg_round_down(frame) == (void *) t &&
+               (uint8_t *) (frame + 2) <= stack_end &&
+               is_kernel_vaddr((void *) frame[1])) {
+            s->pc[s->depth++] = frame[1];
+            if ((uint32_t *) frame[0] <= frame)
+                break;
+            frame = (uint32_t *) frame[0];
+        }
+    }
+
+    remember_thread(t);
+}
+
+/*! Records the name of T, if it has not been seen yet. */
+static void remember_thread(const struct thread *t) {
+    size_t i;
+
+    for (i = 0; i < thread_cnt; i++)
+        if (threads[i].tid == t->tid)
+            return;
+    if (thread_cnt < PROFILE_THREADS) {
+        threads[thread_cnt].tid = t->tid;
+        strlcpy(threads[thread_cnt].name, t->name,
+                sizeof threads[thread_cnt].name);
+        thread_cnt++;
+    }
+}
+
+/*! Dumps the samples, oldest first, if -profile was given. */
+void profile_print_stats(void) {
+    uint64_t first, i;
+    size_t j;
+
+    if (samples == NULL)
+        return;
+
+    first = sample_cnt > PROFILE_SAMPLES ? sample_cnt - PROFILE_SAMPLES : 0;
+    printf("Profile: %llu samples, %llu overwritten\n", sample_cnt, first);
+    for (j = 0; j < thread_cnt; j++)
+        printf("Profile thread %d %s\n", threads[j].tid, threads[j].name);
+    for (i = first; i < sample_cnt; i++) {
+        const struct sample *s = &samples[i % PROFILE_SAMPLES];
+        int k;
+
+        printf("Profile sample %d %c", s->tid, s->user ? 'U' : 'K');
+        for (k = 0; k < s->depth; k++)
+            printf(" %#x", s->pc[k]);
+        printf("\n");
+    }
+}
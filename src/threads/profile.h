@@ -0,0 +1,15 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+struct intr_frame;
+
+/*! Sampling profiler (-profile option). */
+extern bool profile_enabled;
+
+void profile_init(void);
+void profile_sample(const struct intr_frame *);
+void profile_print_stats(void);
+
+#endif /* threads/profile.h */
@@ -59,7 +59,8 @@ static inline uintptr_t pd_no(const void *va) {
    +------------------------------------+------------------------+
 \endverbatim
 
-    In a PDE, the physical address points to a page table.
+    In a PDE, the physical address points to a page table, or,
+    if PTE_PS is set, to a 4 MB page (see pde_create_large()).
     In a PTE, the physical address points to a data or code page.
     The important flags are listed below.
     When a PDE or PTE is not "present", the other flags are
@@ -75,8 +76,14 @@ static inline uintptr_t pd_no(const void *va) {
 #define PTE_U 0x4               /*!< 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /*!< 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /*!< 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /*!< 1=4 MB page (PDEs only). */
+#define PTE_G 0x100             /*!< 1=global, kept across CR3 loads. */
 /*! @} */
 
+/*! CR4 bits. */
+#define CR4_PSE 0x10            /*!< Allow 4 MB pages. */
+#define CR4_PGE 0x80            /*!< Honor PTE_G. */
+
 /*! Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create(uint32_t *pt) {
     ASSERT(pg_ofs(pt) == 0);
@@ -87,9 +94,19 @@ static inline uint32_t pde_create(uint32_t *pt) {
     PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt(uint32_t pde) {
     ASSERT(pde & PTE_P);
+    ASSERT(!(pde & PTE_PS));
     return ptov(pde & PTE_ADDR);
 }
 
+/*! Returns a PDE that maps the 4 MB of memory at PAGE, which must
+    be 4 MB aligned, as a single page usable only by the kernel.
+    If WRITABLE is true then it will be writable as well.  The
+    CPU must have CR4_PSE set. */
+static inline uint32_t pde_create_large(void *page, bool writable) {
+    ASSERT(((uintptr_t) page & (PTSPAN - 1)) == 0);
+    return vtop(page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /*! Returns a PTE that points to PAGE.
     The PTE's page is readable.
     If WRITABLE is true then it will be writable as well.
@@ -0,0 +1,244 @@
+/*! \file slab.c
+
+   Slab allocator.  Where malloc() rounds each request up to a
+   power of 2, a slab cache hands out objects of one exact size,
+   for kernel structures that are allocated and freed often.
+
+   Each cache gets whole pages, called "slabs", from the page
+   allocator.  A slab starts with a header and is carved into as
+   many objects as fit after it.  Free objects in a slab are
+   chained into a free list through a link word, which overlays
+   the start of the object unless the cache has a constructor.
+   A constructor is run once on each object when its slab is
+   created, and objects are expected to be in their constructed
+   state again when they are freed, so the link then goes past
+   the end of the object instead.
+
+   A cache keeps the slabs that have both free and allocated
+   objects on a list and allocates from the first of them.
+   Full slabs are on no list.  When a slab becomes entirely free
+   it is kept as a spare if the cache has none, and otherwise
+   given back to the page allocator. */
+
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/*! Object alignment. */
+#define SLAB_ALIGN sizeof (void *)
+
+/*! Cache. */
+struct kmem_cache {
+    const char *name;           /*!< Name, for statistics. */
+    size_t size;                /*!< Object size in bytes. */
+    size_t stride;              /*!< Distance between objects. */
+    size_t link_ofs;            /*!< Offset of the free-list link. */
+    size_t objs_per_slab;       /*!< Number of objects in a slab. */
+    void (*ctor)(void *);       /*!< Constructor, or NULL. */
+    struct list partial;        /*!< Slabs with some objects free. */
+    struct slab *spare;         /*!< An entirely free slab, or NULL. */
+    struct lock lock;           /*!< Lock. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /*!< Slabs held, including the spare. */
+    size_t in_use;              /*!< Objects allocated. */
+    size_t max_in_use;          /*!< Most objects allocated at once. */
+    unsigned long long alloc_cnt;  /*!< Successful allocations. */
+    unsigned long long fail_cnt;   /*!< Failed allocations. */
+};
+
+/*! Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab7a6e
+
+/*! Slab header, at the start of each slab's page. */
+struct slab {
+    unsigned magic;             /*!< Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /*!< Owning cache. */
+    size_t in_use;              /*!< Objects allocated from this slab. */
+    void *free;                 /*!< First free object, or NULL. */
+    struct list_elem elem;      /*!< Element in cache's partial list. */
+};
+
+/*! Offset of the first object in a slab. */
+#define SLAB_FIRST ROUND_UP(sizeof (struct slab), SLAB_ALIGN)
+
+/*! All caches. */
+#define KMEM_CACHE_MAX 32
+static struct kmem_cache caches[KMEM_CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab *slab_create(struct kmem_cache *);
+static void **free_link(const struct kmem_cache *, void *obj);
+
+/*! Creates a cache of objects of SIZE bytes, called NAME in the
+    statistics.  If CTOR is nonnull, it is called on each object
+    when it first becomes available, and freed objects must be
+    left in the state it produces.  Caches are never destroyed. */
+struct kmem_cache * kmem_cache_create(const char *name, size_t size,
+                                      void (*ctor)(void *)) {
+    struct kmem_cache *c;
+    enum intr_level old_level;
+
+    ASSERT(name != NULL);
+    ASSERT(size > 0);
+
+    old_level = intr_disable();
+    ASSERT(cache_cnt < KMEM_CACHE_MAX);
+    c = &caches[cache_cnt++];
+    intr_set_level(old_level);
+
+    c->name = name;
+    c->size = size;
+    c->ctor = ctor;
+    if (ctor == NULL) {
+        c->link_ofs = 0;
+        c->stride = ROUND_UP(size < sizeof (void *) ? sizeof (void *) : size,
+                             SLAB_ALIGN);
+    }
+    else {
+        c->link_ofs = ROUND_UP(size, SLAB_ALIGN);
+        c->stride = c->link_ofs + sizeof (void *);
+    }
+    c->objs_per_slab = (PGSIZE - SLAB_FIRST) / c->stride;
+    ASSERT(c->objs_per_slab > 0);
+    list_init(&c->partial);
+    c->spare = NULL;
+    lock_init(&c->lock);
+    return c;
+}
+
+/*! Allocates an object from cache C.  Returns a null pointer if
+    memory is not available. */
+void * kmem_cache_alloc(struct kmem_cache *c) {
+    struct slab *s;
+    void *obj;
+
+    ASSERT(c != NULL);
+
+    lock_acquire(&c->lock);
+    if (!list_empty(&c->partial))
+        s = list_entry(list_front(&c->partial), struct slab, elem);
+    else {
+        if (c->spare != NULL) {
+            s = c->spare;
+            c->spare = NULL;
+        }
+        else {
+            s = slab_create(c);
+            if (s == NULL) {
+                c->fail_cnt++;
+                lock_release(&c->lock);
+                return NULL;
+            }
+        }
+        list_push_front(&c->partial, &s->elem);
+    }
+
+    /* Take the first free object. */
+    obj = s->free;
+    s->free = *free_link(c, obj);
+    if (++s->in_use == c->objs_per_slab)
+        list_remove(&s->elem);
+
+    c->alloc_cnt++;
+    if (++c->in_use > c->max_in_use)
+        c->max_in_use = c->in_use;
+    lock_release(&c->lock);
+
+    return obj;
+}
+
+/*! Returns OBJ, which must have been allocated from cache C, to
+    C.  Does nothing if OBJ is a null pointer. */
+void kmem_cache_free(struct kmem_cache *c, void *obj) {
+    struct slab *s;
+
+    if (obj == NULL)
+        return;
+
+    s = pg_round_down(obj);
+    ASSERT(s->magic == SLAB_MAGIC);
+    ASSERT(s->cache == c);
+    ASSERT((pg_ofs(obj) - SLAB_FIRST) % c->stride == 0);
+
+    lock_acquire(&c->lock);
+    ASSERT(s->in_use > 0);
+    *free_link(c, obj) = s->free;
+    s->free = obj;
+    c->in_use--;
+
+    /* A full slab becomes partial again. */
+    if (s->in_use-- == c->objs_per_slab)
+        list_push_front(&c->partial, &s->elem);
+
+    /* Keep one entirely free slab, give back the others. */
+    if (s->in_use == 0) {
+        list_remove(&s->elem);
+        if (c->spare == NULL)
+            c->spare = s;
+        else {
+            c->slab_cnt--;
+            palloc_free_page(s);
+        }
+    }
+    lock_release(&c->lock);
+}
+
+/*! Prints statistics for each cache that has been used. */
+void kmem_cache_print_stats(void) {
+    size_t i;
+
+    for (i = 0; i < cache_cnt; i++) {
+        struct kmem_cache *c = &caches[i];
+        if (c->alloc_cnt == 0 && c->fail_cnt == 0)
+            continue;
+        printf("Slab %s: %zu-byte objects, %zu in use (max %zu), "
+               "%zu slabs, %llu allocations, %llu failures\n",
+               c->name, c->size, c->in_use, c->max_in_use, c->slab_cnt,
+               c->alloc_cnt, c->fail_cnt);
+    }
+}
+
+/*! Gets a new slab for cache C, constructs its objects and chains
+    them into its free list.  Returns a null pointer if memory is
+    not available. */
+static struct slab * slab_create(struct kmem_cache *c) {
+    struct slab *s;
+    uint8_t *obj;
+    size_t i;
+
+    s = palloc_get_page(0);
+    if (s == NULL)
+        return NULL;
+
+    s->magic = SLAB_MAGIC;
+    s->cache = c;
+    s->in_use = 0;
+    s->free = NULL;
+
+    /* Chain the objects from last to first, so that they are
+       handed out in address order. */
+    obj = (uint8_t *) s + SLAB_FIRST + c->objs_per_slab * c->stride;
+    for (i = 0; i < c->objs_per_slab; i++) {
+        obj -= c->stride;
+        if (c->ctor != NULL)
+            c->ctor(obj);
+        *free_link(c, obj) = s->free;
+        s->free = obj;
+    }
+
+    c->slab_cnt++;
+    return s;
+}
+
+/*! Returns the free-list link word of OBJ in cache C. */
+static void ** free_link(const struct kmem_cache *c, void *obj) {
+    return (void **) ((uint8_t *) obj + c->link_ofs);
+}
@@ -0,0 +1,15 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/*! A cache of same-sized objects.  See slab.c. */
+struct kmem_cache;
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+                                     void (*ctor)(void *));
+void *kmem_cache_alloc(struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free(struct kmem_cache *, void *);
+void kmem_cache_print_stats(void);
+
+#endif /* threads/slab.h */
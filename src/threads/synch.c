@@ -34,9 +34,47 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/*! A thread waiting on a condition variable, with the semaphore it
+    sleeps on. */
+struct semaphore_elem {
+    struct pheap_elem elem;             /*!< Heap element. */
+    struct semaphore semaphore;         /*!< This semaphore. */
+    struct condition *cond;             /*!< Condition waited on. */
+    struct thread *thread;              /*!< The waiting thread. */
+    unsigned seq;                       /*!< Order of arrival. */
+};
+
+/*! Lock statistics, one entry per lock name. */
+#define LOCK_STAT_CNT 64
+static struct lock_stat lock_stats[LOCK_STAT_CNT];
+static size_t lock_stat_cnt;
+
+/*! If true, keep lock statistics (-lockstat option). */
+bool lock_stat_enabled;
+
+/*! If false, semaphores and locks always take the slow path, which
+    the lock-fast test clears to time what the fast path saves. */
+bool sema_fast_path = true;
+
+/*! Number of times the slow path has been taken. */
+uint64_t sema_slow_cnt;
+
+static struct lock_stat *lock_stat_lookup(const char *name);
+static void lock_stat_acquired(struct lock *, bool contended,
+                               uint64_t wait_start);
+static void lock_stat_released(struct lock *);
+
+static bool wait_less_func(const struct pheap_elem *a,
+                           const struct pheap_elem *b,
+                           void *aux UNUSED);
+static bool cond_less_func(const struct pheap_elem *a,
+			   const struct pheap_elem *b,
+			   void *aux UNUSED);
+
 /*! Initializes semaphore SEMA to VALUE.  A semaphore is a
     nonnegative integer along with two atomic operators for
     manipulating it:
@@ -49,19 +87,68 @@
 void sema_init(struct semaphore *sema, unsigned value) {
     ASSERT(sema != NULL);
 
-    sema->value = value;
-    list_init(&sema->waiters);
+    sema->value = value * SEMA_ONE;
+    pheap_init(&sema->waiters, wait_less_func, NULL);
+}
+
+/* Atomically replaces *P by NEW if it still holds OLD.  Returns true if
+   it did.  A single instruction, so it cannot be split by an interrupt. */
+static inline bool cas(unsigned *p, unsigned old, unsigned new) {
+  unsigned prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev == old;
+}
+
+/* Uncontended down: takes one unit of SEMA with a compare-and-swap if its
+   count is positive, without disabling interrupts. */
+static inline bool sema_down_fast(struct semaphore *sema) {
+  unsigned v;
+  if (!sema_fast_path)
+    return false;
+  while ((v = sema->value) >= SEMA_ONE)
+    if (cas(&sema->value, v, v - SEMA_ONE))
+      return true;
+  return false;
 }
 
-/* Comparison for thread objects to keep lists sorted. Note that this
-   is actually inverted. */
-bool pri_less_func(const struct list_elem *a,
-		   const struct list_elem *b,
-		   void *aux UNUSED) {
+/* Uncontended up: adds one unit to SEMA with a compare-and-swap if no
+   thread is waiting on it.  Setting SEMA_WAITERS makes the swap fail, so a
+   thread that starts waiting in between is never missed. */
+static inline bool sema_up_fast(struct semaphore *sema) {
+  unsigned v;
+  if (!sema_fast_path)
+    return false;
+  while (!((v = sema->value) & SEMA_WAITERS))
+    if (cas(&sema->value, v, v + SEMA_ONE))
+      return true;
+  return false;
+}
+
+/* Stamps the order in which threads start waiting, so that wait queues
+   can be FIFO among threads of equal priority. */
+static unsigned wait_seq;
+
+/* Returns true if a thread of priority PA that started waiting at SA
+   should be woken before one of priority PB that started at SB. */
+static inline bool wait_before(int pa, unsigned sa, int pb, unsigned sb) {
+  if (pa != pb)
+    return pa > pb;
+  return (int) (sa - sb) < 0;
+}
+
+/* Comparison for threads in a wait queue: higher priority first, then
+   first come, first served. */
+static bool wait_less_func(const struct pheap_elem *a,
+                           const struct pheap_elem *b,
+                           void *aux UNUSED) {
   struct thread *ta, *tb;
-  ta = list_entry(a, struct thread, elem);
-  tb = list_entry(b, struct thread, elem);
-  return (get_thread_priority(ta) > get_thread_priority(tb));
+  ta = pheap_entry(a, struct thread, waitelem);
+  tb = pheap_entry(b, struct thread, waitelem);
+  return wait_before(get_thread_priority(ta), ta->wait_seq,
+                     get_thread_priority(tb), tb->wait_seq);
 }
 
 /*! Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -76,15 +163,19 @@ void sema_down(struct semaphore *sema) {
     ASSERT(sema != NULL);
     ASSERT(!intr_context());
 
+    if (sema_down_fast(sema))
+      return;
+
     thread_current()->blsema = sema;
     old_level = intr_disable();
-    while (sema->value == 0) {
-      list_insert_ordered(&sema->waiters, &thread_current()->elem,
-      			  pri_less_func, 0);
-      //list_push_back(&sema->waiters, &thread_current()->elem);
+    sema_slow_cnt++;
+    while (sema->value < SEMA_ONE) {
+      sema->value |= SEMA_WAITERS;
+      thread_current()->wait_seq = wait_seq++;
+      pheap_push(&sema->waiters, &thread_current()->waitelem);
       thread_block();
     }
-    sema->value--;
+    sema->value -= SEMA_ONE;
     intr_set_level(old_level);
     thread_current()->blsema = NULL;
 }
@@ -100,14 +191,14 @@ bool sema_try_down(struct semaphore *sema) {
 
     ASSERT(sema != NULL);
 
+    if (sema_fast_path)
+      return sema_down_fast(sema);
+
     old_level = intr_disable();
-    if (sema->value > 0) {
-        sema->value--;
-        success = true; 
-    }
-    else {
-      success = false;
-    }
+    sema_slow_cnt++;
+    success = sema->value >= SEMA_ONE;
+    if (success)
+      sema->value -= SEMA_ONE;
     intr_set_level(old_level);
 
     return success;
@@ -122,12 +213,18 @@ void sema_up(struct semaphore *sema) {
 
     ASSERT(sema != NULL);
 
+    if (sema_up_fast(sema))
+      return;
+
     old_level = intr_disable();
-    if (!list_empty(&sema->waiters)) {
-        thread_unblock(list_entry(list_pop_front(&sema->waiters),
-                                  struct thread, elem));
+    sema_slow_cnt++;
+    if (!pheap_empty(&sema->waiters)) {
+        thread_unblock(pheap_entry(pheap_pop(&sema->waiters),
+                                   struct thread, waitelem));
     }
-    sema->value++;
+    if (pheap_empty(&sema->waiters))
+      sema->value &= ~SEMA_WAITERS;
+    sema->value += SEMA_ONE;
     intr_set_level(old_level);
     maybe_yield();
 }
@@ -177,12 +274,117 @@ static void sema_test_helper(void *sema_) {
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
-void lock_init(struct lock *lock) {
+   instead of a lock.
+
+   NAME identifies the lock in the statistics kept with the
+   -lockstat option.  Locks given the same name, such as the
+   locks of all open inodes, share their statistics. */
+void lock_init_named(struct lock *lock, const char *name) {
     ASSERT(lock != NULL);
+    ASSERT(name != NULL);
 
     lock->holder = NULL;
     sema_init(&lock->semaphore, 1);
+    lock->stat = lock_stat_enabled ? lock_stat_lookup(name) : NULL;
+}
+
+/*! Returns the statistics for locks named NAME, registering NAME if it is
+    new, or NULL if the table is full.  A leading '&' is ignored. */
+static struct lock_stat *lock_stat_lookup(const char *name) {
+    struct lock_stat *ls;
+    enum intr_level old_level;
+
+    if (*name == '&')
+        name++;
+
+    old_level = intr_disable();
+    for (ls = lock_stats; ls < lock_stats + lock_stat_cnt; ls++)
+        if (!strcmp(ls->name, name))
+            break;
+    if (ls == lock_stats + LOCK_STAT_CNT)
+        ls = NULL;
+    else if (ls == lock_stats + lock_stat_cnt) {
+        ls->name = name;
+        lock_stat_cnt++;
+    }
+    intr_set_level(old_level);
+
+    return ls;
+}
+
+/*! Records that the current thread acquired LOCK, after waiting since
+    WAIT_START if CONTENDED. */
+static void lock_stat_acquired(struct lock *lock, bool contended,
+                               uint64_t wait_start) {
+    struct lock_stat *ls = lock->stat;
+    enum intr_level old_level;
+    uint64_t now = timer_now_ns();
+
+    old_level = intr_disable();
+    ls->acquired++;
+    if (contended) {
+        ls->contended++;
+        ls->wait_ns += now - wait_start;
+        strlcpy(ls->last_contender, thread_name(),
+                sizeof ls->last_contender);
+    }
+    intr_set_level(old_level);
+    lock->acquire_ns = now;
+}
+
+/*! Records that LOCK is being released. */
+static void lock_stat_released(struct lock *lock) {
+    struct lock_stat *ls = lock->stat;
+    enum intr_level old_level;
+    uint64_t held = timer_now_ns() - lock->acquire_ns;
+
+    old_level = intr_disable();
+    if (held > ls->max_hold_ns)
+        ls->max_hold_ns = held;
+    intr_set_level(old_level);
+}
+
+/*! Copies the statistics for locks named NAME into *STAT.  Returns
+    false if no such locks have been initialized with -lockstat. */
+bool lock_stat_get(const char *name, struct lock_stat *stat) {
+    struct lock_stat *ls;
+    enum intr_level old_level;
+    bool found = false;
+
+    ASSERT(name != NULL);
+    ASSERT(stat != NULL);
+
+    if (*name == '&')
+        name++;
+
+    old_level = intr_disable();
+    for (ls = lock_stats; ls < lock_stats + lock_stat_cnt; ls++)
+        if (!strcmp(ls->name, name)) {
+            *stat = *ls;
+            found = true;
+            break;
+        }
+    intr_set_level(old_level);
+
+    return found;
+}
+
+/*! Prints the statistics of every lock that was acquired, if
+    -lockstat was given. */
+void lock_print_stats(void) {
+    struct lock_stat *ls;
+
+    if (!lock_stat_enabled)
+        return;
+
+    printf("Locks: %zu names registered\n", lock_stat_cnt);
+    for (ls = lock_stats; ls < lock_stats + lock_stat_cnt; ls++)
+        if (ls->acquired > 0)
+            printf("  %s: %llu acquired, %llu contended, %llu us waited, "
+                   "%llu us max hold, last contender %s\n",
+                   ls->name, ls->acquired, ls->contended,
+                   ls->wait_ns / 1000, ls->max_hold_ns / 1000,
+                   ls->contended > 0 ? ls->last_contender : "none");
 }
 
 /*! Acquires LOCK, sleeping until it becomes available if
@@ -195,10 +397,20 @@ void lock_init(struct lock *lock) {
     we need to sleep. */
 void lock_acquire(struct lock *lock) {
   int i;  
+  bool contended = false;
+  uint64_t wait_start = 0;
     ASSERT(lock != NULL);
     ASSERT(!intr_context());
     ASSERT(!lock_held_by_current_thread(lock));
 
+    /* Nobody holds the lock: take it with a single compare-and-swap and
+       skip the donation walk. */
+    if (sema_down_fast(&lock->semaphore))
+      goto acquired;
+
+    contended = true;
+    if (lock->stat != NULL)
+      wait_start = timer_now_ns();
     i = intr_disable();
     struct thread *t = lock->holder;
     if (!thread_mlfqs) { // Not even going to bother
@@ -221,14 +433,17 @@ void lock_acquire(struct lock *lock) {
 	  // this than to just remove it and put it back.
 	  reinsert(t);
 	}
+	// Its priority only went up, so raising it in the heaps it waits
+	// in is enough to keep them in order.
+	if (t->blcond != NULL)
+	  pheap_raise(&t->blcond->cond->waiters, &t->blcond->elem);
       }
       else
 	break;
       if (t->bllock != NULL) {
 	// Since it's blocked, update its priority inside that lock as well
-	list_remove(&t->elem);
-	list_insert_ordered(&(t->bllock->semaphore.waiters), &t->elem,
-			    pri_less_func, 0);
+	if (t->status == THREAD_BLOCKED)
+	  pheap_raise(&t->bllock->semaphore.waiters, &t->waitelem);
 
 	// Go to the next thread
 	t = t->bllock->holder;
@@ -237,11 +452,8 @@ void lock_acquire(struct lock *lock) {
 	// It might still be blocked on a semaphore (if it was blocked on
 	// a lock, then it will also be blocked on a semaphore; I don't feel
 	// like reordering the code to take advantage of this
-	if (t->blsema != NULL) {
-	  list_remove(&t->elem);
-	  list_insert_ordered(&(t->blsema->waiters), &t->elem,
-			      pri_less_func, 0);
-	}
+	if (t->blsema != NULL && t->status == THREAD_BLOCKED)
+	  pheap_raise(&t->blsema->waiters, &t->waitelem);
 	break;
       }
     }
@@ -251,9 +463,14 @@ void lock_acquire(struct lock *lock) {
     intr_set_level(i);
     sema_down(&lock->semaphore);
     thread_current()->bllock = NULL;
+acquired:
     lock->holder = thread_current();
     if(thread_current()->locks)
       list_push_back(thread_current()->locks, &lock->elem);
+    /* Only after the holder is set, so that contenders can donate to
+       us while the statistics are being recorded. */
+    if (lock->stat != NULL)
+      lock_stat_acquired(lock, contended, wait_start);
     // Since we have the lock, that means all other processes blocked on this
     // lock have at most the same priority, so we don't need to update that.
 }
@@ -273,7 +490,10 @@ bool lock_try_acquire(struct lock *lock) {
     success = sema_try_down(&lock->semaphore);
     if (success) {
       lock->holder = thread_current();
-      list_push_back(thread_current()->locks, &lock->elem);
+      if (thread_current()->locks)
+        list_push_back(thread_current()->locks, &lock->elem);
+      if (lock->stat != NULL)
+        lock_stat_acquired(lock, false, 0);
     }
 
     return success;
@@ -288,6 +508,8 @@ void lock_release(struct lock *lock) {
     ASSERT(lock != NULL);
     ASSERT(lock_held_by_current_thread(lock));
 
+    if (lock->stat != NULL)
+      lock_stat_released(lock);
     lock->holder = NULL;
     if ((!thread_mlfqs) && thread_current()->locks) {
       list_remove(&lock->elem);
@@ -295,9 +517,9 @@ void lock_release(struct lock *lock) {
       // I'm only mostly convinced that this is right; it should be an
       // invariant that the head of the waiters list has the highest
       // nested priority donated through that lock.
-      if ((!list_empty(&lock->semaphore.waiters)) && 
+      if ((!pheap_empty(&lock->semaphore.waiters)) && 
 	  // (thread_current()->cur_pri != thread_current()->priority)) {
-	  (thread_current()->cur_pri == list_entry(list_begin(&lock->semaphore.waiters), struct thread, elem)->cur_pri)) {
+	  (thread_current()->cur_pri == pheap_entry(pheap_top(&lock->semaphore.waiters), struct thread, waitelem)->cur_pri)) {
 	thread_current()->cur_pri = thread_current()->priority;
 	get_donated_priority(thread_current());
       }
@@ -314,35 +536,26 @@ bool lock_held_by_current_thread(const struct lock *lock) {
     return lock->holder == thread_current();
 }
 
-/*! One semaphore in a list. */
-struct semaphore_elem {
-    struct list_elem elem;              /*!< List element. */
-    struct semaphore semaphore;         /*!< This semaphore. */
-};
-
 /*! Initializes condition variable COND.  A condition variable
     allows one piece of code to signal a condition and cooperating
     code to receive the signal and act upon it. */
 void cond_init(struct condition *cond) {
     ASSERT(cond != NULL);
 
-    list_init(&cond->waiters);
+    pheap_init(&cond->waiters, cond_less_func, NULL);
 }
 
-/* Comparison for semaphore elements to keep lists sorted. Note that this
-   is actually inverted. It is assumed that the semaphore actually has
-   a thread blocked on it; this is true in our usage case. */
-static bool cond_less_func(const struct list_elem *a,
-			   const struct list_elem *b,
+/* Comparison for condition variable waiters, like wait_less_func(). The
+   thread is recorded in the waiter, since it may not have blocked on the
+   semaphore yet. */
+static bool cond_less_func(const struct pheap_elem *a,
+			   const struct pheap_elem *b,
 			   void *aux UNUSED) {
   struct semaphore_elem *sa, *sb;
-  struct thread *ta, *tb;
-  sa = list_entry(a, struct semaphore_elem, elem);
-  sb = list_entry(b, struct semaphore_elem, elem);
-  ta = list_entry(list_begin(&sa->semaphore.waiters), struct thread, elem);
-  tb = list_entry(list_begin(&sb->semaphore.waiters), struct thread, elem);
-  
-  return (get_thread_priority(ta) > get_thread_priority(tb));
+  sa = pheap_entry(a, struct semaphore_elem, elem);
+  sb = pheap_entry(b, struct semaphore_elem, elem);
+  return wait_before(get_thread_priority(sa->thread), sa->seq,
+                     get_thread_priority(sb->thread), sb->seq);
 }
 
 /*! Atomically releases LOCK and waits for COND to be signaled by
@@ -374,13 +587,13 @@ void cond_wait(struct condition *cond, struct lock *lock) {
     ASSERT(lock_held_by_current_thread(lock));
   
     sema_init(&waiter.semaphore, 0);
+    waiter.cond = cond;
+    waiter.thread = thread_current();
     int i = intr_disable();
-    list_push_back(&cond->waiters, &waiter.elem);
+    waiter.seq = wait_seq++;
+    pheap_push(&cond->waiters, &waiter.elem);
+    thread_current()->blcond = &waiter;
     intr_set_level(i);
-    /* Here we don't need to keep the list sorted for anything else (for the
-       semaphore O(1) access to the highest priority thread is useful); if
-       we tried we would have to keep track of which condition variables each
-       lock is used for, which incurs some overhead.*/
     lock_release(lock);
     sema_down(&waiter.semaphore);
     lock_acquire(lock);
@@ -399,11 +612,16 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED) {
     ASSERT(!intr_context ());
     ASSERT(lock_held_by_current_thread (lock));
 
-    if (!list_empty(&cond->waiters)) {
-      struct list_elem *e = list_min(&cond->waiters, cond_less_func, 0);
-      list_remove(e);
-        sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
+    /* Take the waiter out and wake it atomically, so that a priority
+       donation never finds its BLCOND pointing to a removed waiter. */
+    int i = intr_disable();
+    if (!pheap_empty(&cond->waiters)) {
+      struct semaphore_elem *waiter =
+        pheap_entry(pheap_pop(&cond->waiters), struct semaphore_elem, elem);
+      waiter->thread->blcond = NULL;
+      sema_up(&waiter->semaphore);
     }
+    intr_set_level(i);
     maybe_yield();
 }
 
@@ -417,7 +635,7 @@ void cond_broadcast(struct condition *cond, struct lock *lock) {
     ASSERT(cond != NULL);
     ASSERT(lock != NULL);
 
-    while (!list_empty(&cond->waiters))
+    while (!pheap_empty(&cond->waiters))
         cond_signal(cond, lock);
 }
 
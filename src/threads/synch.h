@@ -8,36 +8,68 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pheap.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /*! A counting semaphore. */
 struct semaphore {
-    unsigned value;             /*!< Current value. */
-    struct list waiters;        /*!< List of waiting threads. */
+    unsigned value;             /*!< Count * SEMA_ONE | SEMA_WAITERS. */
+    struct pheap waiters;       /*!< Waiting threads, by priority. */
 };
 
+/*! Semaphore value word.  The count is kept above the low bit, which is
+    set while WAITERS may be nonempty, so that uncontended sema_down() and
+    sema_up() are a single compare-and-swap on VALUE. */
+#define SEMA_WAITERS 1u         /*!< Some thread may be waiting. */
+#define SEMA_ONE 2u             /*!< A count of one. */
+
+extern bool sema_fast_path;
+extern uint64_t sema_slow_cnt;
+
 void sema_init(struct semaphore *, unsigned value);
 void sema_down(struct semaphore *);
 bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
 void sema_self_test(void);
 
+/*! Contention statistics, shared by all locks initialized under the same
+    name while lock_stat_enabled. */
+struct lock_stat {
+    const char *name;           /*!< Name given to lock_init(). */
+    uint64_t acquired;          /*!< Acquisitions. */
+    uint64_t contended;         /*!< Acquisitions that had to wait. */
+    uint64_t wait_ns;           /*!< Total time spent waiting. */
+    uint64_t max_hold_ns;       /*!< Longest time held. */
+    char last_contender[16];    /*!< Last thread that had to wait. */
+};
+
+extern bool lock_stat_enabled;
+
 /*! Lock. */
 struct lock {
     struct thread *holder;      /*!< Thread holding lock (for debugging). */
     struct semaphore semaphore; /*!< Binary semaphore controlling access. */
   struct list_elem elem; /* List element */
+    struct lock_stat *stat;     /*!< Statistics, or NULL if not kept. */
+    uint64_t acquire_ns;        /*!< When the holder acquired it. */
 };
 
-void lock_init(struct lock *);
+/*! Initializes a lock, naming it after the expression that
+    designates it, e.g. "fs_lock" for lock_init(&fs_lock). */
+#define lock_init(LOCK) lock_init_named(LOCK, #LOCK)
+
+void lock_init_named(struct lock *, const char *name);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_held_by_current_thread(const struct lock *);
+bool lock_stat_get(const char *name, struct lock_stat *);
+void lock_print_stats(void);
 
 /*! Condition variable. */
 struct condition {
-    struct list waiters;        /*!< List of waiting threads. */
+    struct pheap waiters;       /*!< Waiting threads, by priority. */
 };
 
 void cond_init(struct condition *);
@@ -45,10 +77,6 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
-bool pri_less_func(const struct list_elem *a,
-		   const struct list_elem *b,
-		   void *aux);
-
 /*! Optimization barrier.
 
    The compiler will not reorder operations across an
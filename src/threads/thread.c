@@ -9,8 +9,10 @@
 #include "threads/intr-stubs.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "threads/fixed_point.h"
 #include "devices/timer.h"
@@ -35,9 +37,53 @@
 // };
 
 
-/*! List of processes in THREAD_READY state, that is, processes
-    that are ready to run but not actually running. */
-static struct list ready_list;
+/*! Run queue: processes in THREAD_READY state, that is, processes
+    that are ready to run but not actually running.  There is one FIFO
+    queue per priority; bit P of BITMAP is set iff QUEUES[P] is
+    nonempty, so the highest ready priority is found in O(1).
+
+    Each CPU has its own run queue.  A ready thread waits on the queue
+    of the CPU it last ran on, and new threads go to the least loaded
+    CPU.  A CPU whose queue is empty steals the best thread of the
+    busiest other queue before it goes idle.
+
+    Only the boot processor runs, so with -cpus=N it serves the N
+    queues in turn, moving on to the next CPU at every thread switch.
+    Priorities are then only kept within each CPU, as they would be on
+    N processors.  The default is a single CPU, which schedules exactly
+    as a single run queue would. */
+#define RQ_NQUEUES (PRI_MAX - PRI_MIN + 1)
+struct runqueue {
+    struct list queues[RQ_NQUEUES];     /*!< FIFO queue per priority. */
+    uint64_t bitmap;                    /*!< Nonempty queues. */
+    size_t cnt;                         /*!< # of threads in QUEUES. */
+    unsigned long long steal_cnt;       /*!< Threads taken from others. */
+};
+
+static struct runqueue runqueues[THREAD_CPU_MAX];
+
+/*! Number of CPUs scheduled, set by -cpus=N. */
+unsigned thread_cpu_cnt = 1;
+
+/*! CPU the boot processor is currently serving. */
+static unsigned cur_cpu;
+
+/*! Returns the run queue of the running CPU. */
+static inline struct runqueue *this_rq(void) {
+    return &runqueues[cur_cpu];
+}
+
+/*! Returns the run queue that T waits on while it is ready. */
+static inline struct runqueue *thread_rq(const struct thread *t) {
+    return &runqueues[t->cpu];
+}
+
+static void rq_push(struct runqueue *, struct thread *);
+static void rq_remove(struct runqueue *, struct thread *);
+static int rq_top_priority(const struct runqueue *);
+static size_t rq_ready_cnt(void);
+static unsigned rq_least_loaded(void);
+static struct thread *rq_steal(struct runqueue *);
 
 /*! List of all processes.  Processes are added to this list
     when they are first scheduled and removed when they exit. */
@@ -50,6 +96,11 @@ static struct thread *idle_thread;
 static struct thread *initial_thread;
 //static struct thread_ashes initial_thread_ashes;
 
+#ifdef USERPROG
+/*! Cache of thread_ashes, one per child thread. */
+static struct kmem_cache *ashes_cache;
+#endif
+
 /*! Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -109,10 +160,20 @@ static tid_t allocate_tid(void);
     It is not safe to call thread_current() until this function finishes. */
 void thread_init(void) {
     //struct thread_ashes *a;
+    struct runqueue *rq;
+    int i;
+
     ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(thread_cpu_cnt >= 1 && thread_cpu_cnt <= THREAD_CPU_MAX);
 
     lock_init(&tid_lock);
-    list_init(&ready_list);
+    for (rq = runqueues; rq < runqueues + THREAD_CPU_MAX; rq++) {
+        for (i = 0; i < RQ_NQUEUES; i++)
+            list_init(&rq->queues[i]);
+        rq->bitmap = 0;
+        rq->cnt = 0;
+        rq->steal_cnt = 0;
+    }
     list_init(&all_list);
 
     /* Set up a thread structure for the running thread. */
@@ -135,6 +196,11 @@ void thread_init(void) {
 /*! Starts preemptive thread scheduling by enabling interrupts.
     Also creates the idle thread. */
 void thread_start(void) {
+#ifdef USERPROG
+    ashes_cache = kmem_cache_create("thread_ashes",
+                                    sizeof(struct thread_ashes), NULL);
+#endif
+
     /* Create the idle thread. */
     struct semaphore idle_started;
     sema_init(&idle_started, 0);
@@ -228,9 +294,12 @@ void thread_tick(void) {
 }
 
 void tick_mlfqs(void) {
+    struct runqueue *rq;
     struct thread *t0 = thread_current();
     struct thread *t1;
     struct list_elem *e;
+    struct list requeue;
+    int p;
 
     int32_t ready_running_threads;
     // damping factor for recent_cpu per second
@@ -241,22 +310,31 @@ void tick_mlfqs(void) {
     if (timer_ticks() % 4 == 0) {
         t0->priority = auto_priority(t0);
 
-        if (!list_empty(&ready_list)) {
-            for (e = list_front(&ready_list); 
-                 e != list_tail(&ready_list); 
-                 e = list_next(e)) {
-                t1 = list_entry(e, struct thread, elem);
+        for (rq = runqueues; rq < runqueues + thread_cpu_cnt; rq++) {
+            if (rq->cnt == 0)
+                continue;
+
+            /* Drain the queues from highest to lowest priority, then
+               requeue every thread under its new priority.  This keeps
+               the FIFO order within each priority and is O(n), where
+               sorting a single list was O(n log n). */
+            list_init(&requeue);
+            for (p = PRI_MAX; p >= PRI_MIN; p--)
+                while (!list_empty(&rq->queues[p]))
+                    list_push_back(&requeue,
+                                   list_pop_front(&rq->queues[p]));
+            rq->bitmap = 0;
+            rq->cnt = 0;
+
+            while (!list_empty(&requeue)) {
+                t1 = list_entry(list_pop_front(&requeue), struct thread, elem);
                 t1->priority = auto_priority(t1);
-                //reinsert(t1);
-		/* Sorting the entire list is faster (O(n log n) instead
-		   of O(n^2) */
+                rq_push(rq, t1);
             }
-	    list_sort(&ready_list, pri_less_func, 0);
-            t1 = list_entry(list_front(&ready_list), struct thread, elem);
-
-            if (t0->priority < t1->priority)
-                intr_yield_on_return();
         }
+
+        if (t0->priority < rq_top_priority(this_rq()))
+            intr_yield_on_return();
 	
     }
 
@@ -267,7 +345,7 @@ void tick_mlfqs(void) {
     /* Do once per second */
     if (timer_ticks() % TIMER_FREQ == 0) {
         /* Count threads that are running or ready to run */
-        ready_running_threads = (t0 != idle_thread) + list_size(&ready_list);
+        ready_running_threads = (t0 != idle_thread) + rq_ready_cnt();
 
         cpu_damp = fp_div_fp(2 * load_avg, fp_add_int(2 * load_avg, 1));
 
@@ -275,12 +353,16 @@ void tick_mlfqs(void) {
 
         t0->recent_cpu = fp_add_int(fp_mul_fp(cpu_damp, t0->recent_cpu), t0->nice);
 
-        if (!list_empty(&ready_list)) {
-            for (e = list_front(&ready_list); 
-                 e != list_tail(&ready_list); 
-                 e = list_next(e)) {
-                t1 = list_entry(e, struct thread, elem);
-                t1->recent_cpu = fp_add_int(fp_mul_fp(cpu_damp, t1->recent_cpu), t1->nice);
+        for (rq = runqueues; rq < runqueues + thread_cpu_cnt; rq++) {
+            for (p = PRI_MIN; p <= PRI_MAX; p++) {
+                if (!(rq->bitmap & ((uint64_t) 1 << p)))
+                    continue;
+                for (e = list_begin(&rq->queues[p]);
+                     e != list_end(&rq->queues[p]);
+                     e = list_next(e)) {
+                    t1 = list_entry(e, struct thread, elem);
+                    t1->recent_cpu = fp_add_int(fp_mul_fp(cpu_damp, t1->recent_cpu), t1->nice);
+                }
             }
         }
 
@@ -294,8 +376,14 @@ void tick_mlfqs(void) {
 
 /*! Prints thread statistics. */
 void thread_print_stats(void) {
+    unsigned cpu;
+
     printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
            idle_ticks, kernel_ticks, user_ticks);
+    if (thread_cpu_cnt > 1)
+        for (cpu = 0; cpu < thread_cpu_cnt; cpu++)
+            printf("CPU %u: %llu threads stolen\n",
+                   cpu, runqueues[cpu].steal_cnt);
 }
 
 /*! Creates a new kernel thread named NAME with the given initial PRIORITY,
@@ -344,7 +432,7 @@ tid_t thread_create(const char *name, int priority, thread_func *function,
 #ifdef USERPROG
     struct thread_ashes *a;
     /* Init ashes */
-    a = t->ashes = malloc(sizeof(struct thread_ashes));
+    a = t->ashes = kmem_cache_alloc(ashes_cache);
 //printf("a=%lu\n", a);
     a->tid = tid;
     a->has_been_waited = false;
@@ -382,7 +470,8 @@ tid_t thread_create(const char *name, int priority, thread_func *function,
     sf->eip = switch_entry;
     sf->ebp = 0;
 
-    /* Add to run queue. */
+    /* Add to the run queue of the least loaded CPU. */
+    t->cpu = rq_least_loaded();
     thread_unblock(t);
     
     // Yield if the new thread has higher priority
@@ -401,6 +490,7 @@ void thread_block(void) {
     ASSERT(!intr_context());
     ASSERT(intr_get_level() == INTR_OFF);
 
+    TRACE(TRACE_BLOCK, 0);
     thread_current()->status = THREAD_BLOCKED;
     schedule();
 }
@@ -419,7 +509,8 @@ void thread_unblock(struct thread *t) {
 
     old_level = intr_disable();
     ASSERT(t->status == THREAD_BLOCKED);
-    list_insert_ordered(&ready_list, &t->elem, pri_less_func, 0);
+    TRACE(TRACE_UNBLOCK, t->tid);
+    rq_push(thread_rq(t), t);
     t->status = THREAD_READY;
     intr_set_level(old_level);
 }
@@ -427,8 +518,10 @@ void thread_unblock(struct thread *t) {
 /* Yields if the current thread has lower priority than the first thread in
    the ready queue and not in interrupt context */
 void maybe_yield() {
-  if ((! intr_context()) && (! list_empty(&ready_list)))
-    if (thread_current()->priority < list_entry(list_begin(&ready_list),
+  struct runqueue *rq = this_rq();
+  int top = rq_top_priority(rq);
+  if ((! intr_context()) && top >= 0)
+    if (thread_current()->priority < list_entry(list_begin(&rq->queues[top]),
 				struct thread, elem)-> priority)
       thread_yield();
 }
@@ -438,8 +531,8 @@ void maybe_yield() {
 // (usually a good idea while working
 // with lists, especially static or global ones)
 void reinsert(struct thread *t) {
-  list_remove(&t->elem);
-  list_insert_ordered(&ready_list, &t->elem, pri_less_func, 0);
+  rq_remove(thread_rq(t), t);
+  rq_push(thread_rq(t), t);
 }
 
 /*! Returns the name of the running thread. */
@@ -504,6 +597,8 @@ void thread_exit(void) {
         sema_up(&cur->ashes->sema);
 #endif
 
+    malloc_thread_exit();
+
     /* Remove thread from all threads list, set our status to dying,
        and schedule another process.  That process will destroy us
        when it calls thread_schedule_tail(). */
@@ -524,7 +619,7 @@ void thread_yield(void) {
 
     old_level = intr_disable();
     if (cur != idle_thread) {
-      list_insert_ordered(&ready_list, &cur->elem, pri_less_func, 0);
+      rq_push(thread_rq(cur), cur);
     }
     cur->status = THREAD_READY;
     schedule();
@@ -552,10 +647,10 @@ void get_donated_priority(struct thread *t) {
 	    e != list_end(t->locks); e = list_next(e)) {
 	struct lock *l = list_entry(e, struct lock, elem);
 	// Check the "priority" of the lock, if any
-	struct list *z = &l->semaphore.waiters;
-	if (! list_empty(z)) {	  
+	struct pheap *z = &l->semaphore.waiters;
+	if (! pheap_empty(z)) {	  
 	  int i = intr_disable();
-	  int p = list_entry(list_begin(z), struct thread, elem)->cur_pri;
+	  int p = pheap_entry(pheap_top(z), struct thread, waitelem)->cur_pri;
 	  // We do need to avoid a race condition here though (another thread
 	  // can increase our cur_pri, and then we'll set it to the wrong
 	  // value).
@@ -600,10 +695,10 @@ void set_priority(int new_priority) {
 	    e != list_end(thread_current()->locks); e = list_next(e)) {
 	struct lock *l = list_entry(e, struct lock, elem);
 	// Check the "priority" of the lock, if any
-	struct list *z = &l->semaphore.waiters;
-	if (! list_empty(z)) {
+	struct pheap *z = &l->semaphore.waiters;
+	if (! pheap_empty(z)) {
 	  int i = intr_disable();
-	  int p = list_entry(list_begin(z), struct thread, elem)->cur_pri;
+	  int p = pheap_entry(pheap_top(z), struct thread, waitelem)->cur_pri;
 	  // We do need to avoid a race condition here though (another thread
 	  // can increase our cur_pri; p being increased doesn't matter,
 	  // because that will also update our cur_pri if needed.
@@ -673,8 +768,22 @@ static void idle(void *idle_started_ UNUSED) {
     for (;;) {
         /* Let someone else run. */
         intr_disable();
+        timer_idle_exit();
         thread_block();
 
+        /* Zero free pages for PAL_ZERO requests, one at a time, until
+           a thread becomes ready or there is nothing left to zero. */
+        intr_enable();
+        while (rq_ready_cnt() == 0 && palloc_zero_idle())
+            continue;
+        intr_disable();
+        if (rq_ready_cnt() > 0)
+            continue;
+
+        /* With dynamic ticks, skip the timer interrupts until the next
+           tick that has work to do. */
+        timer_idle_enter();
+
         /* Re-enable interrupts and wait for the next one.
 
            The `sti' instruction disables interrupts until the completion of
@@ -752,12 +861,115 @@ static void * alloc_frame(struct thread *t, size_t size) {
 /*! Chooses and returns the next thread to be scheduled.  Should return a
     thread from the run queue, unless the run queue is empty.  (If the running
     thread can continue running, then it will be in the run queue.)  If the
-    run queue is empty, return idle_thread. */
+    run queue is empty, steals a thread from another CPU, and if there is none
+    to steal, returns idle_thread.
+
+    The boot processor moves on to the next CPU first. */
 static struct thread * next_thread_to_run(void) {
-    if (list_empty(&ready_list))
-      return idle_thread;
-    else
-      return list_entry(list_pop_front(&ready_list), struct thread, elem);
+    struct runqueue *rq;
+    struct thread *t;
+    int top;
+
+    if (++cur_cpu == thread_cpu_cnt)
+        cur_cpu = 0;
+    rq = this_rq();
+    top = rq_top_priority(rq);
+
+    if (top < 0) {
+      t = rq_steal(rq);
+      return t != NULL ? t : idle_thread;
+    }
+
+    t = list_entry(list_front(&rq->queues[top]), struct thread, elem);
+    rq_remove(rq, t);
+    return t;
+}
+
+/*! Appends T to the queue in RQ for its current priority.  Must be
+    called with interrupts off. */
+static void rq_push(struct runqueue *rq, struct thread *t) {
+    int p = get_thread_priority(t);
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(p >= PRI_MIN && p <= PRI_MAX);
+
+    t->ready_pri = p;
+    list_push_back(&rq->queues[p], &t->elem);
+    rq->bitmap |= (uint64_t) 1 << p;
+    rq->cnt++;
+}
+
+/*! Removes T from the queue in RQ it was pushed on.  T's priority may
+    have changed since, so the queue is taken from T->ready_pri.  Must be
+    called with interrupts off. */
+static void rq_remove(struct runqueue *rq, struct thread *t) {
+    int p = t->ready_pri;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    list_remove(&t->elem);
+    if (list_empty(&rq->queues[p]))
+        rq->bitmap &= ~((uint64_t) 1 << p);
+    rq->cnt--;
+}
+
+/*! Returns the highest priority with a ready thread in RQ, or -1 if RQ
+    is empty.  The bitmap is scanned in 32-bit halves so that
+    __builtin_clz() does not pull in libgcc's 64-bit helper. */
+static int rq_top_priority(const struct runqueue *rq) {
+    uint32_t hi = rq->bitmap >> 32;
+    uint32_t lo = rq->bitmap;
+
+    if (hi != 0)
+        return 63 - __builtin_clz(hi);
+    if (lo != 0)
+        return 31 - __builtin_clz(lo);
+    return -1;
+}
+
+/*! Returns the number of ready threads on all CPUs. */
+static size_t rq_ready_cnt(void) {
+    size_t cnt = 0;
+    unsigned cpu;
+
+    for (cpu = 0; cpu < thread_cpu_cnt; cpu++)
+        cnt += runqueues[cpu].cnt;
+    return cnt;
+}
+
+/*! Returns the CPU with the fewest ready threads. */
+static unsigned rq_least_loaded(void) {
+    unsigned best = 0, cpu;
+
+    for (cpu = 1; cpu < thread_cpu_cnt; cpu++)
+        if (runqueues[cpu].cnt < runqueues[best].cnt)
+            best = cpu;
+    return best;
+}
+
+/*! Takes the highest priority thread of the busiest other CPU for
+    RQ, which is empty, and moves it to RQ's CPU.  Returns the thread,
+    or a null pointer if no other CPU has a ready thread.  Must be
+    called with interrupts off. */
+static struct thread *rq_steal(struct runqueue *rq) {
+    struct runqueue *victim = NULL, *r;
+    struct thread *t;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(rq->cnt == 0);
+
+    for (r = runqueues; r < runqueues + thread_cpu_cnt; r++)
+        if (r->cnt > 0 && (victim == NULL || r->cnt > victim->cnt))
+            victim = r;
+    if (victim == NULL)
+        return NULL;
+
+    t = list_entry(list_front(&victim->queues[rq_top_priority(victim)]),
+                   struct thread, elem);
+    rq_remove(victim, t);
+    t->cpu = rq - runqueues;
+    rq->steal_cnt++;
+    return t;
 }
 
 /*! Completes a thread switch by activating the new thread's page tables, and,
@@ -812,7 +1024,8 @@ void thread_schedule_tail(struct thread *prev) {
             // printf("parent %s\n", prev->name);
             // printf("child  %d\n", a->exit_status);
             // free(a);
-            free(list_entry(e, struct thread_ashes, elem));
+            kmem_cache_free(ashes_cache,
+                            list_entry(e, struct thread_ashes, elem));
         }
     }
 #endif
@@ -835,8 +1048,10 @@ static void schedule(void) {
     ASSERT(cur->status != THREAD_RUNNING);
     ASSERT(is_thread(next));
 
-    if (cur != next)
+    if (cur != next) {
+        TRACE(TRACE_SWITCH, next->tid);
         prev = switch_threads(cur, next);
+    }
     thread_schedule_tail(prev);
 }
 
@@ -9,6 +9,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/malloc.h"
 #include "threads/synch.h"
 
 #include "filesys/file.h"
@@ -102,11 +103,13 @@ typedef int tid_t;
    value, triggering the assertion.
 
    The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list.
+   the run queue (thread.c), or it can be an element in a list of
+   blocked threads, such as the swap slot waiters (vm/swap.c).  It
+   can be used these two ways only because they are mutually
+   exclusive: only a thread in the ready state is on the run queue,
+   whereas only a thread in the blocked state is on a wait list.
+   Threads blocked on a semaphore wait in a priority heap through
+   `waitelem' instead.
 */
 struct thread {
     /*! Owned by thread.c. */
@@ -120,17 +123,22 @@ struct thread {
     int nice;                       /*!< Niceness. */
     int cur_pri; /* Current priority; at least as large as priority */
     int recent_cpu; /* Amount of CPU time used recently */
+    int ready_pri;  /* Run queue holding this thread while THREAD_READY */
+    unsigned cpu;   /* CPU whose run queue it waits on, or last ran on */
     struct list_elem allelem;           /*!< List element for all threads list. */
 
     struct list *locks; /* Currently held locks */
     struct lock *bllock; /* Lock currently blocked on, if any */
     struct semaphore *blsema; /* Ditto, but semaphore. The reason we still need
                                  the lock is to implement nesting */
+    struct semaphore_elem *blcond; /* Condition variable wait, if any */
     /**@}*/
 
     /*! Shared between thread.c and synch.c. */
     /**@{*/
     struct list_elem elem;              /*!< List element. */
+    struct pheap_elem waitelem;         /*!< Semaphore wait queue element. */
+    unsigned wait_seq;                  /*!< Order of arrival in the queue. */
     /**@}*/
 
 #ifdef USERPROG
@@ -160,6 +168,11 @@ struct thread {
     //bool load_success;
 #endif /* USERPROG */
 
+    /*! Owned by malloc.c. */
+    /**@{*/
+    struct magazine *mags[MALLOC_CLASS_CNT]; /*!< Free blocks by size. */
+    /**@}*/
+
 #ifdef FILESYS
   struct dir *curdir;
   size_t cache_waiting;
@@ -176,6 +189,13 @@ struct thread {
     Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/*! Most CPUs the scheduler keeps run queues for. */
+#define THREAD_CPU_MAX 8
+
+/*! Number of CPUs scheduled, each with its own run queue.  Controlled
+    by kernel command-line option "-cpus=N". */
+extern unsigned thread_cpu_cnt;
+
 void thread_init(void);
 void thread_start(void);
 
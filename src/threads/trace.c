@@ -0,0 +1,165 @@
+/*! \file trace.c
+
+   Kernel event tracing.  Tracepoints placed with TRACE() throughout
+   the kernel record compact binary events, time-stamped with the
+   CPU's time-stamp counter, into a ring buffer that keeps the most
+   recent TRACE_EVENTS of them.  A slot is claimed with a single
+   locked instruction, so tracepoints take no locks and may fire in
+   interrupt handlers, even in the middle of another tracepoint.
+
+   At power-off the buffer is dumped, either to the console or, with
+   -trace=scratch, in binary to the scratch block device.
+   utils/pintos-trace decodes either dump into a timeline. */
+
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <rdtsc.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef FILESYS
+#include "devices/block.h"
+#endif
+
+/*! The ring buffer. */
+#define TRACE_PAGES 64
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+static struct trace_event *events;
+static uint32_t event_cnt;      /*!< Events recorded, modulo 2**32. */
+
+/*! Dump to the scratch device instead of the console? */
+static bool dump_to_scratch;
+
+/*! If true, tracepoints record events (-trace option). */
+bool trace_enabled;
+
+#ifdef FILESYS
+/*! Header in the first sector of a dump to a block device. */
+struct trace_header {
+    char magic[8];              /*!< "PINTRACE". */
+    uint32_t event_cnt;         /*!< Events that follow. */
+    uint32_t lost_cnt;          /*!< Older events overwritten or cut. */
+    uint64_t tsc_hz;            /*!< For converting time stamps. */
+};
+
+static bool dump_block(struct block *, uint32_t first, uint32_t cnt,
+                       uint32_t lost);
+#endif
+
+/*! Allocates the ring buffer and starts tracing.  OUTPUT says where
+    to dump the events: "console" or "scratch". */
+void trace_init(const char *output) {
+    if (!strcmp(output, "scratch")) {
+#ifndef FILESYS
+        PANIC("-trace=scratch needs a kernel with a file system");
+#endif
+        dump_to_scratch = true;
+    }
+    else if (strcmp(output, "console"))
+        PANIC("unknown trace output `%s' (use -h for help)", output);
+
+    events = palloc_get_multiple(PAL_ASSERT, TRACE_PAGES);
+    trace_enabled = true;
+}
+
+/*! Records an event of TYPE with argument ARG.  Called by TRACE(). */
+void trace_event(enum trace_type type, uint32_t arg) {
+    struct trace_event *e;
+    uint32_t *esp;
+    struct thread *t;
+    uint32_t slot = 1;
+
+    /* Claim a slot atomically with respect to interrupts. */
+    asm volatile ("lock xaddl %0, %1"
+                  : "+r" (slot), "+m" (event_cnt) : : "memory");
+    e = &events[slot % TRACE_EVENTS];
+
+    /* Find the running thread the way running_thread() does, since
+       thread_current() objects while the scheduler is switching. */
+    asm ("mov %%esp, %0" : "=g" (esp));
+    t = pg_round_down(esp);
+
+    e->tsc = rdtsc();
+    e->type = type;
+    e->tid = t->tid;
+    e->arg = arg;
+}
+
+/*! Stops tracing and dumps the recorded events, oldest first. */
+void trace_dump(void) {
+    uint32_t cnt, first, i;
+
+    if (events == NULL)
+        return;
+    trace_enabled = false;
+
+    cnt = event_cnt < TRACE_EVENTS ? event_cnt : TRACE_EVENTS;
+    first = event_cnt - cnt;
+
+#ifdef FILESYS
+    if (dump_to_scratch) {
+        struct block *scratch = block_get_role(BLOCK_SCRATCH);
+        if (scratch == NULL)
+            printf("Trace: no scratch device, dumping to console\n");
+        else if (dump_block(scratch, first, cnt, event_cnt - cnt))
+            return;
+    }
+#endif
+
+    printf("Trace: %"PRIu32" events, %"PRIu32" lost, %"PRIu64" Hz\n",
+           cnt, event_cnt - cnt, timer_tsc_hz());
+    for (i = first; i != event_cnt; i++) {
+        const struct trace_event *e = &events[i % TRACE_EVENTS];
+        printf("Trace event %"PRIx64" %u %u %"PRIx32"\n",
+               e->tsc, e->type, e->tid, e->arg);
+    }
+}
+
+#ifdef FILESYS
+/*! Writes the CNT events starting at FIRST to block device B after a
+    header, dropping the oldest events if B is too small.  Returns
+    false if B cannot even hold the header. */
+static bool dump_block(struct block *b, uint32_t first, uint32_t cnt,
+                       uint32_t lost) {
+    static uint8_t sector[BLOCK_SECTOR_SIZE];
+    enum { PER_SECTOR = BLOCK_SECTOR_SIZE / sizeof (struct trace_event) };
+    struct trace_header *h = (struct trace_header *) sector;
+    block_sector_t size = block_size(b);
+    block_sector_t s;
+    uint32_t i;
+
+    if (size < 1)
+        return false;
+    if (cnt > (size - 1) * PER_SECTOR) {
+        uint32_t cut = cnt - (size - 1) * PER_SECTOR;
+        first += cut;
+        cnt -= cut;
+        lost += cut;
+    }
+
+    memset(sector, 0, sizeof sector);
+    memcpy(h->magic, "PINTRACE", sizeof h->magic);
+    h->event_cnt = cnt;
+    h->lost_cnt = lost;
+    h->tsc_hz = timer_tsc_hz();
+    block_write(b, 0, sector);
+
+    for (s = 1, i = 0; i < cnt; s++) {
+        struct trace_event *out = (struct trace_event *) sector;
+        size_t j;
+
+        memset(sector, 0, sizeof sector);
+        for (j = 0; j < PER_SECTOR && i < cnt; j++, i++)
+            out[j] = events[(first + i) % TRACE_EVENTS];
+        block_write(b, s, sector);
+    }
+
+    printf("Trace: %"PRIu32" events, %"PRIu32" lost, written to %s\n",
+           cnt, lost, block_name(b));
+    return true;
+}
+#endif
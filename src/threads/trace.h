@@ -0,0 +1,50 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*! Kernel events recorded by TRACE().  utils/pintos-trace knows them
+    by number, so new types go at the end. */
+enum trace_type {
+    TRACE_SWITCH,               /*!< Context switch; ARG is the next tid. */
+    TRACE_BLOCK,                /*!< thread_block(). */
+    TRACE_UNBLOCK,              /*!< thread_unblock(); ARG is the woken tid. */
+    TRACE_PAGE_IN,              /*!< Page fault; ARG is the fault address. */
+    TRACE_PAGE_OUT,             /*!< Eviction; ARG is the user page. */
+    TRACE_SWAP_READ,            /*!< Swap in; ARG is the swap slot. */
+    TRACE_SWAP_WRITE,           /*!< Swap out; ARG is the swap slot. */
+    TRACE_CACHE_HIT,            /*!< Buffer cache hit; ARG is the sector. */
+    TRACE_CACHE_MISS,           /*!< Buffer cache miss; ARG is the sector. */
+    TRACE_CACHE_EVICT,          /*!< Cache eviction; ARG is the old sector. */
+    TRACE_BIO_READ,             /*!< Block read issued; ARG is the sector. */
+    TRACE_BIO_WRITE,            /*!< Block write issued; ARG is the sector. */
+    TRACE_BIO_DONE,             /*!< Block I/O completed; ARG is the sector. */
+    TRACE_SYSCALL_ENTER,        /*!< ARG is the system call number. */
+    TRACE_SYSCALL_EXIT          /*!< ARG is the return value. */
+};
+
+/*! An event, as kept in the ring buffer and dumped. */
+struct trace_event {
+    uint64_t tsc;               /*!< Time-stamp counter. */
+    uint16_t type;              /*!< A trace_type. */
+    uint16_t tid;               /*!< Running thread, low 16 bits of tid. */
+    uint32_t arg;               /*!< Depends on TYPE. */
+};
+
+/*! Tracing (-trace option). */
+extern bool trace_enabled;
+
+/*! Records an event of TYPE with argument ARG.  While tracing is
+    off, costs a load and a branch that is predicted not taken. */
+#define TRACE(TYPE, ARG)                                        \
+        do {                                                    \
+            if (__builtin_expect(trace_enabled, 0))             \
+                trace_event(TYPE, (uint32_t) (ARG));            \
+        } while (0)
+
+void trace_init(const char *output);
+void trace_event(enum trace_type, uint32_t arg);
+void trace_dump(void);
+
+#endif /* threads/trace.h */
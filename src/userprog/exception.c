@@ -4,11 +4,13 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 
 #ifdef VM
 #include <round.h>
 #include "threads/synch.h"
 #include "vm/page.h"
+#include "vm/share.h"
 #endif
 
 /*! Number of page faults processed. */
@@ -134,6 +136,7 @@ static void page_fault(struct intr_frame *f) {
 
     /* Count page faults. */
     page_fault_cnt++;
+    TRACE(TRACE_PAGE_IN, fault_addr);
 
     /* Determine cause. */
     not_present = (f->error_code & PF_P) == 0;
@@ -157,7 +160,7 @@ static void page_fault(struct intr_frame *f) {
 
       if (vma != NULL && 
           /* Stack size < 8 MB */
-          (vma->vm_end - (1 << 23) < (uint8_t *) fault_addr) & 
+          (vma->vm_end - VM_STACK_MAX < (uint8_t *) fault_addr) & 
           /* 32 byte below esp is OK (PUSHA) */   
           (esp - 32 <= (uint8_t *) fault_addr) && 
           /* Access above PHYS_BASE is bad */
@@ -171,7 +174,8 @@ static void page_fault(struct intr_frame *f) {
         { 
           .page_ofs = 0,
           .fault_addr = fault_addr, 
-          .user = user
+          .user = user,
+          .write = write
         };
 
         /* Bring in and install a page */
@@ -193,7 +197,8 @@ static void page_fault(struct intr_frame *f) {
         { 
           .page_ofs = (uint32_t) (upage - vma->vm_start),
           .fault_addr = fault_addr, 
-          .user = user
+          .user = user,
+          .write = write
         };
 
         /* Bring in and install a page */
@@ -207,6 +212,13 @@ static void page_fault(struct intr_frame *f) {
       }
 
     }
+    else if (write) {
+      /* Copy-on-write */
+      struct vm_area_struct *vma = mm_find(mm, fault_addr);
+
+      if (vma != NULL && vm_cow_fault(vma, fault_addr, user))
+        return;
+    }
 #endif /* VM */
 
     /* Detection of bad user pointer during system call */
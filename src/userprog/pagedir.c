@@ -12,7 +12,6 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
-static uint32_t *active_pd(void);
 static void invalidate_pagedir(uint32_t *);
 
 /*! Creates a new page directory that has mappings for kernel virtual
@@ -186,7 +185,24 @@ void pagedir_set_accessed(uint32_t *pd, const void *vpage, bool accessed) {
     }
 }
 
-/*! Loads page directory PD into the CPU's page directory base register. */
+/*! Sets the writable bit to WRITABLE in the PTE for virtual page VPAGE
+    in PD. */
+void pagedir_set_writable(uint32_t *pd, const void *vpage, bool writable) {
+    uint32_t *pte = lookup_page(pd, vpage, false);
+    if (pte != NULL) {
+        if (writable) {
+            *pte |= PTE_W;
+        }
+        else {
+            *pte &= ~(uint32_t) PTE_W;
+            invalidate_pagedir(pd);
+        }
+    }
+}
+
+/*! Loads page directory PD into the CPU's page directory base register.
+    This flushes every TLB entry that is not global, even if PD was
+    already active, so it also serves to invalidate the TLB. */
 void pagedir_activate(uint32_t *pd) {
     if (pd == NULL)
         pd = init_page_dir;
@@ -199,7 +215,7 @@ void pagedir_activate(uint32_t *pd) {
 }
 
 /*! Returns the currently active page directory. */
-static uint32_t * active_pd(void) {
+uint32_t * pagedir_active(void) {
     /* Copy CR3, the page directory base register (PDBR), into `pd'.
        See [IA32-v2a] "MOV--Move to/from Control Registers" and
        [IA32-v3a] 3.7.5 "Base Address of the Page Directory". */
@@ -216,7 +232,7 @@ static uint32_t * active_pd(void) {
     (If PD is not active then its entries are not in the TLB, so there is no
     need to invalidate anything.) */
 static void invalidate_pagedir(uint32_t *pd) {
-    if (active_pd() == pd) {
+    if (pagedir_active() == pd) {
         /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
            "Translation Lookaside Buffers (TLBs)". */
         pagedir_activate(pd);
@@ -23,6 +23,7 @@
 #include "vm/frame.h"
 #include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/share.h"
 #endif
 
 //#define PROCESS_C_DEBUG
@@ -135,7 +136,7 @@ static void swap_destructor (struct hash_elem *e, void *aux UNUSED) {
   if (vp->swap > 0)
     swap_free(vp->swap);
 
-  free(vp);
+  kmem_cache_free(vm_page_cachep, vp);
 }
 #endif /* VM */
 
@@ -161,9 +162,10 @@ void process_exit(void) {
 #ifdef VM
   // Write back all mmaps
   struct mm_struct *mm = &cur->mm;
-  struct vm_area_struct *iter = mm->mmap;
+  size_t i;
 
-  while (iter != NULL) {
+  for (i = 0; i < mm->map_count; i++) {
+    struct vm_area_struct *iter = mm->mmap[i];
 
     if (iter->vm_flags & VM_MMAP) {
 
@@ -188,14 +190,20 @@ void process_exit(void) {
         }
     }
 
+    /* Drop shared code pages before pagedir_destroy() frees them */
+    vm_share_unmap_vma(iter);
+
     /* Reclaim swap used by the process */
     hash_destroy(&iter->vm_page_table, swap_destructor);
 
-    /* Clean up vm_area_struct and step */
-    struct vm_area_struct *iter_free = iter;
-    iter = iter->next;
-    free(iter_free);
+    if (iter->vm_shmem != NULL)
+      vm_shmem_unref(iter->vm_shmem);
+
+    /* Clean up vm_area_struct */
+    kmem_cache_free(vm_area_cachep, iter);
   }
+
+  mm_destroy(mm);
 #endif /* VM */
 
 #ifdef FILESYS
@@ -231,13 +239,154 @@ void process_exit(void) {
 void process_activate(void) {
     struct thread *t = thread_current();
 
-    /* Activate thread's page tables. */
-    pagedir_activate(t->PAGEDIR);
+    /* Activate thread's page tables, unless they are already active,
+       so that switching back to the same process keeps its TLB
+       entries.  A kernel thread has no user mappings of its own and
+       simply keeps the page directory of whatever ran before it:
+       its kernel half is the same everywhere.  That page directory
+       cannot be freed meanwhile, because only its own process frees
+       it, after switching to init_page_dir in process_exit(). */
+    if (t->PAGEDIR != NULL && t->PAGEDIR != pagedir_active())
+        pagedir_activate(t->PAGEDIR);
 
     /* Set thread's kernel stack for use in processing interrupts. */
     tss_update();
 }
 
+#ifdef VM
+/* Passed from process_fork() to fork_process() */
+struct fork_args {
+    struct thread *parent;
+    struct intr_frame if_;              /* Parent's user context */
+    struct semaphore done;              /* Upped once the copy is made */
+    bool success;
+};
+
+static thread_func fork_process NO_RETURN;
+
+/* Gives DST its own handle of every file SRC has open, at the same
+   position and with the same descriptor. */
+static bool dup_files(struct thread *dst, struct thread *src) {
+    int i;
+
+    for (i = 0; i < src->nfiles; i++) {
+        struct file_node *from = &src->files[i / 64][i % 64];
+        struct file_node *to;
+
+        if (i % 64 == 0) {
+            dst->files[i / 64] = palloc_get_page(0);
+            if (dst->files[i / 64] == NULL)
+                return false;
+        }
+        to = &dst->files[i / 64][i % 64];
+
+        lock_acquire(&fs_lock);
+        to->f = file_reopen(from->f);
+        if (to->f != NULL)
+            file_seek(to->f, file_tell(from->f));
+        lock_release(&fs_lock);
+
+        if (to->f == NULL) {
+            if (i % 64 == 0)
+                palloc_free_page(dst->files[i / 64]);
+            return false;
+        }
+
+        to->fd = from->fd;
+        dst->nfiles++;
+    }
+
+    return true;
+}
+
+/*! A thread function that copies the address space of the parent and
+    returns to user mode where the parent made the fork system call. */
+static void fork_process(void *args_) {
+    struct fork_args *args = args_;
+    struct thread *cur = thread_current();
+    struct thread *parent = args->parent;
+    struct intr_frame if_ = args->if_;
+    bool success = false;
+
+    mm_init(&cur->mm);
+    cur->PAGEDIR = pagedir_create();
+    if (cur->PAGEDIR == NULL)
+        goto done;
+    process_activate();
+
+    lock_acquire(&fs_lock);
+    cur->exec = file_reopen(parent->exec);
+    if (cur->exec != NULL)
+        file_deny_write(cur->exec);
+    lock_release(&fs_lock);
+
+    /* Segments first, then their pages copy-on-write */
+    if (cur->exec == NULL ||
+        !mm_dup(&cur->mm, &parent->mm, cur->exec) ||
+        !vm_cow_dup(&cur->mm, &parent->mm) ||
+        !dup_files(cur, parent))
+        goto done;
+
+#ifdef FILESYS
+    if (cur->curdir == NULL)
+        cur->curdir = dir_open_root();
+#endif
+
+    cur->esp = if_.esp;
+    success = true;
+
+done:
+    cur->ashes->load_success = success;
+    args->success = success;
+    sema_up(&cur->load_done);
+
+    /* ARGS lives on the parent's stack: do not touch it after this */
+    sema_up(&args->done);
+
+    if (!success)
+        thread_exit();
+
+    /* The child sees fork() return 0 */
+    if_.eax = 0;
+    asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+    NOT_REACHED();
+}
+#endif /* VM */
+
+/*! Creates a child process running a copy of the current one, which
+    resumes from the user context F.  Writable pages are shared
+    copy-on-write rather than copied.  Returns the child's thread id, or
+    TID_ERROR if it cannot be created. */
+#ifdef VM
+tid_t process_fork(struct intr_frame *f) {
+    struct thread *cur = thread_current();
+    struct fork_args args;
+    tid_t tid;
+
+    args.parent = cur;
+    args.if_ = *f;
+    args.success = false;
+    sema_init(&args.done, 0);
+
+    tid = thread_create(cur->name, PRI_DEFAULT, fork_process, &args);
+    if (tid == TID_ERROR)
+        return TID_ERROR;
+
+    /* Our address space must hold still while the child copies it */
+    sema_down(&args.done);
+
+    if (!args.success) {
+        process_wait(tid);
+        return TID_ERROR;
+    }
+    return tid;
+}
+#else
+tid_t process_fork(struct intr_frame *f UNUSED) {
+    return TID_ERROR;
+}
+#endif /* VM */
+
 /*! We load ELF binaries.  The following definitions are taken
     from the ELF specification, [ELF1], more-or-less verbatim.  */
 
@@ -303,6 +452,9 @@ struct Elf32_Phdr {
 /*! @} */
 
 static bool setup_stack(void **esp, char *exec_name, char *saveptr);
+#ifdef VM
+static bool setup_heap(uint8_t *start);
+#endif
 static bool validate_segment(const struct Elf32_Phdr *, struct file *);
 static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
                          uint32_t read_bytes, uint32_t zero_bytes,
@@ -318,6 +470,7 @@ bool load(const char *file_name, void (**eip) (void), void **esp) {
     struct Elf32_Ehdr ehdr;
     struct file *file = NULL;
     off_t file_ofs;
+    uint8_t *seg_end = NULL;
     bool success = false;
     int i;
 
@@ -432,6 +585,8 @@ bool load(const char *file_name, void (**eip) (void), void **esp) {
                 if (!load_segment(file, file_page, (void *) mem_page,
                                   read_bytes, zero_bytes, writable))
                     goto done;
+                if ((uint8_t *) mem_page + read_bytes + zero_bytes > seg_end)
+                    seg_end = (uint8_t *) mem_page + read_bytes + zero_bytes;
             }
             else {
                 goto done;
@@ -450,6 +605,12 @@ bool load(const char *file_name, void (**eip) (void), void **esp) {
     if (!stack_suc)
         goto done;
 
+#ifdef VM
+    /* The heap starts out empty right above the highest segment. */
+    if (!setup_heap(seg_end))
+        goto done;
+#endif
+
     /* Start address. */
     *eip = (void (*)(void)) ehdr.e_entry;
 
@@ -519,10 +680,24 @@ static int32_t vm_load_seg_absent(struct vm_area_struct *vma,
 
   struct frame_entry f;
 
-  struct vm_page_struct *vmp_in = malloc(sizeof(struct vm_page_struct));
+  /* Read-only code is shared with other processes running the same file */
+  if (vm_share_eligible(vma))
+    return vm_share_absent(vma, vmf);
+
+  /* Reading BSS that was never written needs no frame */
+  if (!vmf->write && vmf->page_ofs >= (off_t) vma->vm_file_read_bytes &&
+      vm_zero_map(vma, upage_in))
+    return true;
+
+  struct vm_page_struct *vmp_in = kmem_cache_alloc(vm_page_cachep);
+
+  /* A BSS page that is not in swap starts out as all zeroes */
+  struct vm_page_struct *vmp_old = vm_page_lookup(vma, upage_in);
+  bool zeroed = vmf->page_ofs >= (off_t) vma->vm_file_read_bytes &&
+                (vmp_old == NULL || vmp_old->swap == 0);
 
   /* Bring in a frame, possibly evicting a page */
-  kpage = vm_kpage(&vmp_in);
+  kpage = zeroed ? vm_kpage_zero(&vmp_in) : vm_kpage(&vmp_in);
 
   frame_make(&f, vma, upage_in);
   vmp_in->upage = upage_in;
@@ -539,7 +714,7 @@ static int32_t vm_load_seg_absent(struct vm_area_struct *vma,
   if (e != NULL) {
     vmp_in = hash_entry(e, struct vm_page_struct, elem);
     swap_in = vmp_in->swap;
-    free(vmp_in);
+    kmem_cache_free(vm_page_cachep, vmp_in);
   }
 
   /* Pin the new frame for kerkel PF */
@@ -568,7 +743,8 @@ static int32_t vm_load_seg_absent(struct vm_area_struct *vma,
     }
 
     /* Zero the remaining bytes (important!) */
-    memset(kpage + read_bytes, 0, PGSIZE - read_bytes);
+    if (!zeroed)
+      memset(kpage + read_bytes, 0, PGSIZE - read_bytes);
   }
 
   bool success = install_page(upage_in, kpage, vma->vm_flags & VM_WRITE);
@@ -578,66 +754,13 @@ static int32_t vm_load_seg_absent(struct vm_area_struct *vma,
 
   frame_push(&f);
 
-  return success;
-}
-
-/* PF handler subroutine for stack segments */
-static int32_t vm_stack_absent(struct vm_area_struct *vma UNUSED, 
-                               struct vm_fault *vmf)
-{
-  uint8_t *kpage;
-  uint8_t *upage_in = (uint8_t *) ((uint32_t) vmf->fault_addr & ~PGMASK);
-
-  struct frame_entry f;
-
-  struct vm_page_struct *vmp_in = malloc(sizeof(struct vm_page_struct));
-
-  /* Bring in a frame, possibly evicting a page */
-  kpage = vm_kpage(&vmp_in);
-
-  frame_make(&f, vma, upage_in);
-  vmp_in->upage = upage_in;
-  vmp_in->swap = 0;
-
-  vmp_in->pte = (uintptr_t) kpage | PTE_P | PTE_W | PTE_U;
-
-  /* Update shadow page table while retriving swap slot */
-  struct hash_elem *e = hash_replace(&vma->vm_page_table, &vmp_in->elem);
-
-  size_t swap_in = 0;
-
-  if (e != NULL) {
-    vmp_in = hash_entry(e, struct vm_page_struct, elem);
-    swap_in = vmp_in->swap;
-    free(vmp_in);
-  }
-
-  /* Pin the new frame for kerkel PF */
-  if (!vmf->user)
-    frame_entry_pin(&f);
-
-  if (swap_in != 0) {
-    /* Read from swap */
-    swap_lock_acquire(swap_in);
-    swap_read(swap_in, kpage);
-    swap_lock_release(swap_in);
-    swap_free(swap_in);
-  }
-  else {
-    /* Or fill with zeroes */
-    memset(kpage, 0, PGSIZE);
-  }
-
-  bool success = install_page(upage_in, kpage, true);
-
-  frame_push(&f);
+  /* Map the neighbours while the file is hot */
+  if (success && !swap_in)
+    vm_fault_around(vma, upage_in);
 
   return success;
 }
 
-static struct vm_operations_struct vm_stack_ops = 
-  { .absent = vm_stack_absent };
-
 static struct vm_operations_struct vm_load_seg_ops = 
   { .absent = vm_load_seg_absent };
 
@@ -666,7 +789,7 @@ static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
 #ifdef VM
     /* Set up memory area descriptor without loading thanks to almighty VM */
     struct mm_struct *mm = &thread_current()->mm;
-    struct vm_area_struct *vma = malloc(sizeof(struct vm_area_struct));
+    struct vm_area_struct *vma = kmem_cache_alloc(vm_area_cachep);
     vma->vm_start = upage;
     vma->vm_end = upage + read_bytes + zero_bytes;
 
@@ -681,6 +804,8 @@ static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
     vma->vm_file_ofs = ofs;
     vma->vm_file_read_bytes = read_bytes;
     vma->vm_file_zero_bytes = zero_bytes;
+    vma->vm_shmem = NULL;
+    vma->mmap_id = 0;
     mm_insert_vm_area(mm, vma);
 #else /* no-VM */
     lock_acquire(&fs_lock);
@@ -745,14 +870,17 @@ static bool setup_stack(void **esp, char *exec_name, char *saveptr) {
     /* Set up memory area descriptor */
     struct mm_struct *mm = &thread_current()->mm;
     uint32_t *pd = mm->pagedir;
-    struct vm_area_struct *vma = malloc(sizeof(struct vm_area_struct));
+    struct vm_area_struct *vma = kmem_cache_alloc(vm_area_cachep);
     vma->vm_start = upage;
     vma->vm_end = PHYS_BASE;
 
     vma->vm_flags = VM_READ | VM_WRITE;
 
     /* PF handler */
-    vma->vm_ops = &vm_stack_ops;
+    vma->vm_ops = &vm_anon_ops;
+    vma->vm_file = NULL;
+    vma->vm_shmem = NULL;
+    vma->mmap_id = 0;
 
     mm->vma_stack = vma;
     mm_insert_vm_area(mm, vma);
@@ -826,6 +954,34 @@ static bool setup_stack(void **esp, char *exec_name, char *saveptr) {
     return true;
 }
 
+#ifdef VM
+/*! Sets up an empty heap segment at START, which sbrk() grows and
+    shrinks. */
+static bool setup_heap(uint8_t *start) {
+    struct mm_struct *mm = &thread_current()->mm;
+    struct vm_area_struct *vma = kmem_cache_alloc(vm_area_cachep);
+
+    if (vma == NULL)
+        return false;
+
+    vma->vm_start = vma->vm_end = start;
+    vma->vm_flags = VM_READ | VM_WRITE;
+    vma->vm_ops = &vm_anon_ops;
+    vma->vm_file = NULL;
+    vma->vm_shmem = NULL;
+    vma->mmap_id = 0;
+
+    if (!mm_insert_vm_area(mm, vma)) {
+        kmem_cache_free(vm_area_cachep, vma);
+        return false;
+    }
+
+    mm->vma_heap = vma;
+    mm->brk = start;
+    return true;
+}
+#endif
+
 /*! Adds a mapping from user virtual address UPAGE to kernel
     virtual address KPAGE to the page table.
     If WRITABLE is true, the user process may modify the page;
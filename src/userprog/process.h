@@ -3,7 +3,10 @@
 
 #include "threads/thread.h"
 
+struct intr_frame;
+
 tid_t process_execute(const char *file_name);
+tid_t process_fork(struct intr_frame *);
 int process_wait(tid_t);
 void process_exit(void);
 void process_activate(void);
@@ -8,6 +8,7 @@
 #include "userprog/process.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/timer.h"
 
 #ifdef FILESYS
 #include "filesys/inode.h"
@@ -23,6 +24,7 @@ int process_wait(tid_t);
 void shutdown_power_off(void) NO_RETURN;
 
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include <string.h>
@@ -32,6 +34,7 @@ void shutdown_power_off(void) NO_RETURN;
 #include "threads/malloc.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/share.h"
 #endif
 
 struct lock fs_lock;
@@ -160,6 +163,8 @@ static bool pin_func(struct frame_entry *f, void *aux) {
     {
       frame_entry_pin(f);
     }
+  else if (f->share != NULL)
+    vm_share_pin(f->share, v->pagedir, v->vm_start, v->vm_end);
 
   return true;
 }
@@ -168,6 +173,8 @@ static bool unpin_func(struct frame_entry *f, void *aux) {
   uint32_t *pd = aux;
   if (f->pagedir == pd)
     frame_entry_unpin(f);
+  else if (f->share != NULL)
+    vm_share_unpin(f->share, pd);
   return true;
 }
 
@@ -193,8 +200,23 @@ static void pin_frames(uint32_t *pd, uint8_t *start, size_t len)
     }
 }
 
+/* Takes private copies of copy-on-write pages in a pinned buffer, so that
+   writing to it while holding fs_lock does not fault into vm_kpage() */
+static void unshare_frames(uint8_t *start, size_t len)
+{
+  uint8_t *ptr = (uint8_t *) ROUND_DOWN((uintptr_t) start, PGSIZE);
+
+  for (; ptr < start + len; ptr += PGSIZE) {
+    uint8_t *p = ptr < start ? start : ptr;
+    int byte = get_user(p);
+    if (byte < 0 || !put_user(p, byte))
+      thread_exit();
+  }
+}
+
 #else
 static void pin_frames(uint32_t *pd, uint8_t *start, size_t len) {}
+static void unshare_frames(uint8_t *start UNUSED, size_t len UNUSED) {}
 #endif
 
 // Since we have no particular guarantee on what open() will return other
@@ -204,6 +226,8 @@ static int next_fd = 10;
 #ifdef VM
 static int mmap (int fd, void *addr);
 static void munmap (int mapping);
+static int mmap_anon (void *addr, size_t length, int flags);
+static void *sbrk (intptr_t increment);
 #endif
 
 static struct file *find_file(int fd);
@@ -223,6 +247,7 @@ static void syscall_handler(struct intr_frame *f) {
 
   get_user_arg(args, f->esp, 0);
   struct thread *cur = thread_current();
+  TRACE(TRACE_SYSCALL_ENTER, args[0]);
 
   // Technically these are an enum, but C implements enums as ints...
   switch(args[0]) {
@@ -398,6 +423,7 @@ static void syscall_handler(struct intr_frame *f) {
     check_array((void *) args[2], args[3]);
     check_write_array((void *) args[2], args[3]);
     pin_frames(cur->PAGEDIR, (void *) args[2], args[3]);
+    unshare_frames((void *) args[2], args[3]);
 
     if (args[1] == 0) { // stdin
     for(i = 0; i < args[3]; ++i) {
@@ -676,6 +702,46 @@ static void syscall_handler(struct intr_frame *f) {
     }
     break;
 #endif /* FILESYS */
+  case SYS_FORK:
+    f->eax = process_fork(f);
+    break;
+
+    /* void *sbrk (intptr_t increment) */
+    /* Moves the end of the heap by increment bytes and returns the old
+       end, or (void *) -1 if the heap cannot grow or shrink that far. */
+  case SYS_SBRK:
+    get_user_arg(args, f->esp, 1);
+#ifdef VM
+    f->eax = (uint32_t) sbrk(args[1]);
+#else
+    f->eax = (uint32_t) -1;
+#endif
+    break;
+
+    /* mapid_t mmap_anon (void *addr, size_t length, int flags) */
+    /* Maps length bytes of zeroes at addr, private or shared with the
+       children forked afterwards as flags says. */
+  case SYS_MMAP_ANON:
+    get_user_arg(args, f->esp, 1);
+    get_user_arg(args, f->esp, 2);
+    get_user_arg(args, f->esp, 3);
+#ifdef VM
+    f->eax = mmap_anon((void *) args[1], args[2], args[3]);
+#else
+    f->eax = (uint32_t) -1;
+#endif
+    break;
+  case SYS_CLOCK:
+    get_user_arg(args, f->esp, 1);
+    if ((uintptr_t) args[1] > (uintptr_t) PHYS_BASE - sizeof (uint64_t))
+      thread_exit();
+    {
+      uint64_t now = timer_now_ns();
+      for (i = 0; i < (int) sizeof now; i++)
+        if (!put_user((uint8_t *) args[1] + i, ((uint8_t *) &now)[i]))
+          thread_exit();
+    }
+    break;
   default:
     printf("unrecognized system call\n");
     thread_exit();
@@ -684,6 +750,7 @@ static void syscall_handler(struct intr_frame *f) {
 #ifdef VM
   frame_for_each(unpin_func, cur->PAGEDIR);
 #endif /* VM */
+  TRACE(TRACE_SYSCALL_EXIT, f->eax);
   return;
 }
 
@@ -715,7 +782,7 @@ static int32_t vm_mmap_absent(struct vm_area_struct *vma UNUSED,
 
   struct frame_entry f;
 
-  struct vm_page_struct *vmp_in = malloc(sizeof(struct vm_page_struct));
+  struct vm_page_struct *vmp_in = kmem_cache_alloc(vm_page_cachep);
 
   kpage = vm_kpage(&vmp_in);
 
@@ -732,7 +799,7 @@ static int32_t vm_mmap_absent(struct vm_area_struct *vma UNUSED,
   if (e != NULL) {
     vmp_in = hash_entry(e, struct vm_page_struct, elem);
     swap_in = vmp_in->swap;
-    free(vmp_in);
+    kmem_cache_free(vm_page_cachep, vmp_in);
   }
 
   /* Pin the new frame for kerkel PF */
@@ -771,15 +838,21 @@ static int32_t vm_mmap_absent(struct vm_area_struct *vma UNUSED,
 
   frame_push(&f);
 
+  /* Map the neighbours while the file is hot */
+  if (success && !swap_in)
+    vm_fault_around(vma, upage_in);
+
   return success;
 }
 
 static struct vm_operations_struct vm_mmap_ops = 
   { .absent = vm_mmap_absent };
 
+/* ID of the next mapping, of a file or anonymous memory */
+static int id = 2;
+
 static int mmap (int fd, void *addr) {
 
-  static int id = 2;    /* ID of mapped file */
   if (id > 1000000000) {
     // You know, just in case someone decides to open a bazillion files -.-
     id = 2;
@@ -808,7 +881,7 @@ static int mmap (int fd, void *addr) {
 
   /* Try to allocate memory area */
   struct mm_struct *mm = &thread_current()->mm;
-  struct vm_area_struct *vma = malloc(sizeof(struct vm_area_struct));
+  struct vm_area_struct *vma = kmem_cache_alloc(vm_area_cachep);
 
   size_t all_bytes = ROUND_UP(read_bytes, PGSIZE);
   size_t zero_bytes = all_bytes - read_bytes;
@@ -822,12 +895,13 @@ static int mmap (int fd, void *addr) {
   vma->vm_file_ofs = 0;
   vma->vm_file_read_bytes = read_bytes;
   vma->vm_file_zero_bytes = zero_bytes;
+  vma->vm_shmem = NULL;
   vma->mmap_id = id;
 
   if (mm_insert_vm_area(mm, vma)) {
     return id++;
   } else {
-    free(vma);
+    kmem_cache_free(vm_area_cachep, vma);
     return -1;
   }
 
@@ -835,17 +909,15 @@ static int mmap (int fd, void *addr) {
 }
 
 static void munmap (int mapping) {
-  // Go through the mmap list, checking whether it was actually mapped
+  // Go through the segments, checking whether it was actually mapped
   struct mm_struct *mm = &thread_current()->mm;
-  struct vm_area_struct *iter = mm->mmap;
-  struct vm_area_struct *prev = NULL;
-  while (iter != NULL) {
+  size_t i;
+
+  for (i = 0; i < mm->map_count; i++) {
+    struct vm_area_struct *iter = mm->mmap[i];
     if (iter->mmap_id == mapping) {
       if (iter->vm_flags & VM_MMAP) {
-        if (prev != NULL)
-          prev->next = iter->next;
-        else
-          mm->mmap = iter->next;
+        mm_remove_vm_area(mm, iter);
         uint8_t *page;
         int nbytes = iter->vm_file_read_bytes;
         for (page = iter->vm_start; page < iter->vm_end; page += PGSIZE, nbytes -= PGSIZE) {
@@ -860,17 +932,107 @@ static void munmap (int mapping) {
 
           lock_release(&fs_lock);
         }
-        free(iter);
+        /* Drop the frames before the segment can be reused */
+        vm_release_range(iter, iter->vm_start, iter->vm_end);
+        hash_destroy(&iter->vm_page_table, NULL);
+        kmem_cache_free(vm_area_cachep, iter);
         return;
       }      
+      else if (iter->vm_flags & VM_ANON) {
+        mm_remove_vm_area(mm, iter);
+        vm_release_range(iter, iter->vm_start, iter->vm_end);
+        hash_destroy(&iter->vm_page_table, NULL);
+        if (iter->vm_shmem != NULL)
+          vm_shmem_unref(iter->vm_shmem);
+        kmem_cache_free(vm_area_cachep, iter);
+        return;
+      }
       else {
         /* Well, that's not good */
         printf("Tried to unmap non-mmaped area!\n");
         thread_exit();
       }
     }
-    prev = iter;
-    iter = iter->next;
   }
 }
+
+/* Maps LENGTH bytes of zeroes at ADDR, private to the process or, if
+   FLAGS is MAP_SHARED, shared with the children it forks afterwards.
+   Returns the mapping ID, or -1 on failure. */
+static int mmap_anon (void *addr, size_t length, int flags) {
+  struct mm_struct *mm = &thread_current()->mm;
+  struct vm_area_struct *vma;
+  uintptr_t start = (uintptr_t) addr;
+  size_t size = ROUND_UP(length, PGSIZE);
+
+  /* Keep clear of the stack's 8 MB, like the heap */
+  if (start == 0 || start % PGSIZE != 0 || length == 0 ||
+      size < length || (flags != MAP_PRIVATE && flags != MAP_SHARED) ||
+      start > (uintptr_t) PHYS_BASE - VM_STACK_MAX ||
+      size > (uintptr_t) PHYS_BASE - VM_STACK_MAX - start)
+    return -1;
+
+  if (id > 1000000000)
+    id = 2;
+
+  vma = kmem_cache_alloc(vm_area_cachep);
+  if (vma == NULL)
+    return -1;
+
+  vma->vm_start = (uint8_t *) addr;
+  vma->vm_end = vma->vm_start + size;
+  vma->vm_flags = VM_READ | VM_WRITE | VM_ANON;
+  vma->vm_ops = &vm_anon_ops;
+  vma->vm_file = NULL;
+  vma->vm_shmem = NULL;
+  vma->mmap_id = id;
+
+  if (flags == MAP_SHARED) {
+    vma->vm_flags |= VM_SHARED;
+    vma->vm_shmem = vm_shmem_create(size / PGSIZE);
+    if (vma->vm_shmem == NULL) {
+      kmem_cache_free(vm_area_cachep, vma);
+      return -1;
+    }
+  }
+
+  if (!mm_insert_vm_area(mm, vma)) {
+    if (vma->vm_shmem != NULL)
+      vm_shmem_unref(vma->vm_shmem);
+    kmem_cache_free(vm_area_cachep, vma);
+    return -1;
+  }
+
+  return id++;
+}
+
+static void *sbrk (intptr_t increment) {
+  struct mm_struct *mm = &thread_current()->mm;
+  struct vm_area_struct *vma = mm->vma_heap;
+  uintptr_t old_brk = (uintptr_t) mm->brk;
+  uintptr_t brk = old_brk + increment;
+  uint8_t *end;
+
+  /* Stay within the heap, and clear of the stack's 8 MB */
+  if (vma == NULL || brk < (uintptr_t) vma->vm_start ||
+      (increment >= 0 ? brk < old_brk : brk > old_brk) ||
+      brk > (uintptr_t) PHYS_BASE - VM_STACK_MAX)
+    return (void *) -1;
+
+  end = (uint8_t *) ROUND_UP(brk, PGSIZE);
+
+  if (end > vma->vm_end) {
+    if (!mm_resize_vm_area(mm, vma, end))
+      return (void *) -1;
+  }
+  else if (end < vma->vm_end) {
+    uint8_t *old_end = vma->vm_end;
+
+    mm_resize_vm_area(mm, vma, end);
+    vm_release_range(vma, end, old_end);
+  }
+
+  mm->brk = (uint8_t *) brk;
+  return (void *) old_brk;
+}
 #endif /* VM */
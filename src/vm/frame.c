@@ -30,6 +30,7 @@ static inline size_t *next(size_t i) {
 }
 
 static void free_index(size_t i);
+static bool pull_locked(struct frame_entry *, frame_func *, void *aux);
 
 void frame_make(struct frame_entry *f, 
                 struct vm_area_struct *vma, 
@@ -38,6 +39,7 @@ void frame_make(struct frame_entry *f,
   f->vma = vma;
   f->pagedir = vma->vm_mm->pagedir;
   f->upage = upage;
+  f->share = NULL;
   f->flags = 0;
 
   if (vma->vm_flags & VM_EXECUTABLE) {
@@ -81,12 +83,28 @@ void frame_push(struct frame_entry *f)
 }
 
 bool frame_pull(struct frame_entry *f, frame_func *func, void *aux)
+{
+  lock_acquire(&table_lock);
+  return pull_locked(f, func, aux);
+}
+
+/* Like frame_pull(), but gives up instead of waiting if the table is
+   in use, possibly by the caller itself */
+bool frame_try_pull(struct frame_entry *f, frame_func *func, void *aux)
+{
+  if (lock_held_by_current_thread(&table_lock) ||
+      !lock_try_acquire(&table_lock))
+    return false;
+  return pull_locked(f, func, aux);
+}
+
+/* Body of frame_pull(), entered with table_lock held, which it
+   releases */
+static bool pull_locked(struct frame_entry *f, frame_func *func, void *aux)
 {
   size_t i;
   size_t count;
 
-  lock_acquire(&table_lock);
-
   count = table_size;
 
   if (count == 0) {
@@ -143,14 +161,9 @@ void frame_remove_if(frame_func *func, void *aux)
   lock_release(&table_lock);
 }
 
-void frame_init(size_t user_page_limit) {
-  /* Free memory starts at 1 MB and runs to the end of RAM. */
-  uint8_t *free_start = ptov(1024 * 1024);
-  uint8_t *free_end = ptov(init_ram_pages * PGSIZE);
-  size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  if (user_pages > user_page_limit)
-    user_pages = user_page_limit;
+void frame_init(void) {
+  /* Most user pages there can ever be */
+  size_t user_pages = palloc_page_limit(PAL_USER);
 
   ftable = palloc_get_multiple(PAL_ASSERT, 
     DIV_ROUND_UP(user_pages * sizeof(struct frame_entry), PGSIZE));
@@ -6,6 +6,8 @@
 
 #include "vm/page.h"
 
+struct vm_share;
+
 /* Flags for rame table entry */ 
 enum frame_flags
 {
@@ -14,7 +16,8 @@ enum frame_flags
     
     PG_CODE =       0x10,   /* Code segment */
     PG_DATA =       0x20,   /* Data segment */
-    PG_MMAP =       0x40    /* Mapped file segment */
+    PG_MMAP =       0x40,   /* Mapped file segment */
+    PG_SHARED =     0x80    /* Shared code page, see vm/share.h */
 };
 
 /* Frame table entry */ 
@@ -25,13 +28,15 @@ struct frame_entry
 
     struct vm_area_struct *vma; /* Parent memory area descriptor */
 
+    struct vm_share *share;     /* Shared page, or NULL */
+
     size_t prev;                /* Circular queue structure */
     size_t next;
 
     uint32_t flags;
 };
 
-void frame_init(size_t user_page_limit);
+void frame_init(void);
 
 void frame_make (struct frame_entry *, 
                  struct vm_area_struct *vma, 
@@ -43,6 +48,7 @@ void frame_push (struct frame_entry *);
 typedef bool frame_func (struct frame_entry *, void *aux);
 
 bool frame_pull (struct frame_entry *, frame_func *, void *aux);
+bool frame_try_pull (struct frame_entry *, frame_func *, void *aux);
 
 void frame_for_each (frame_func *, void *aux);
 
@@ -2,26 +2,92 @@
 
 #include <debug.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "vm/share.h"
+
+struct kmem_cache *vm_area_cachep;
+struct kmem_cache *vm_page_cachep;
+
+/* Held by the thread in vm_reclaim_page(), whose own allocations must
+   not reclaim again */
+static struct lock reclaim_lock;
+
+/* Creates the object caches for memory area and page descriptors. */
+void vm_page_init(void)
+{
+    vm_area_cachep = kmem_cache_create("vm_area_struct",
+                                       sizeof(struct vm_area_struct), NULL);
+    vm_page_cachep = kmem_cache_create("vm_page_struct",
+                                       sizeof(struct vm_page_struct), NULL);
+    if (vm_area_cachep == NULL || vm_page_cachep == NULL)
+      PANIC("vm_page_init: cannot create object caches");
+    lock_init(&reclaim_lock);
+}
+
+/* Initial number of slots in the segment array */
+#define MM_MAP_INIT 8
 
 void mm_init(struct mm_struct *mm)
 {
+  mm->mmap = NULL;
+  mm->map_count = 0;
+  mm->map_capacity = 0;
+  mm->mmap_cache = NULL;
+  mm->vma_stack = NULL;
+  mm->vma_heap = NULL;
+  mm->brk = NULL;
   lock_init(&mm->mmap_lock_w);
 }
 
+/* Release the segment array. Segments themselves are owned by the caller */
+void mm_destroy(struct mm_struct *mm)
+{
+  free(mm->mmap);
+  mm->mmap = NULL;
+  mm->map_count = mm->map_capacity = 0;
+  mm->mmap_cache = NULL;
+  mm->vma_stack = NULL;
+  mm->vma_heap = NULL;
+}
+
+/* Index of the first segment starting above ADDR */
+static size_t mm_upper_bound(struct mm_struct *mm, uint8_t *addr)
+{
+  size_t lo = 0, hi = mm->map_count;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (mm->mmap[mid]->vm_start <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
 /* Find memory segment given a virtual address */
 struct vm_area_struct *mm_find(struct mm_struct * mm, uint8_t *addr)
 {
-  struct vm_area_struct *vma;
+  struct vm_area_struct *vma = mm->mmap_cache;
+  size_t i;
 
-  if (mm->mmap == NULL)
-    return NULL;
+  /* Faults tend to cluster in the segment that faulted last */
+  if (vma != NULL && vma->vm_start <= addr && addr < vma->vm_end)
+    return vma;
 
-  vma = mm->mmap;
+  i = mm_upper_bound(mm, addr);
+  if (i == 0)
+    return NULL;
 
-  for (; vma != NULL; vma = vma->next)
-    if (vma->vm_start <= addr && addr < vma->vm_end)
-      return vma;
+  vma = mm->mmap[i - 1];
+  if (addr < vma->vm_end) {
+    mm->mmap_cache = vma;
+    return vma;
+  }
 
   return NULL;
 }
@@ -48,48 +114,153 @@ static bool page_less (const struct hash_elem *a,
 /* Insert a segment into memory descriptor */
 bool mm_insert_vm_area(struct mm_struct * mm, struct vm_area_struct * vm)
 {
+  size_t i;
+
   /* Set parent */
   vm->vm_mm = mm;
   vm->pagedir = mm->pagedir;
-  vm->next = NULL;
 
   hash_init(&vm->vm_page_table, page_hash, page_less, NULL);
 
-  if (mm->mmap == NULL)
-  {
-    /* Just use it as head of list */
-    mm->mmap = vm;
+  lock_acquire(&mm->mmap_lock_w);
+
+  /* Find insertion point satisfying 
+     mmap[i - 1]->vm_start <= vm->vm_start < mmap[i]->vm_start */
+  i = mm_upper_bound(mm, vm->vm_start);
+
+  /* No overlapping regions, nor two starting at the same address: the
+     heap starts out empty and must stay first at its address */
+  if ((i > 0 && (mm->mmap[i - 1]->vm_end > vm->vm_start ||
+                 mm->mmap[i - 1]->vm_start == vm->vm_start)) ||
+      (i < mm->map_count && vm->vm_end > mm->mmap[i]->vm_start)) {
+    lock_release(&mm->mmap_lock_w);
+    return false;
   }
-  else
-  {
-    struct vm_area_struct *vma_insert = mm->mmap;
 
-    /* Find insertion point satisfying 
-       vma_insert->vm_start <= vm->vm_start <= vma_insert->next->vm_start  */
-    while (vma_insert->next != NULL && vma_insert->next->vm_start < vm->vm_start)
-    {
-      vma_insert = vma_insert->next;
+  /* Grow the array if full */
+  if (mm->map_count == mm->map_capacity) {
+    size_t capacity = mm->map_capacity ? mm->map_capacity * 2 : MM_MAP_INIT;
+    struct vm_area_struct **mmap = 
+      realloc(mm->mmap, capacity * sizeof *mmap);
+
+    if (mmap == NULL) {
+      lock_release(&mm->mmap_lock_w);
+      return false;
     }
 
-    lock_acquire(&mm->mmap_lock_w);
+    mm->mmap = mmap;
+    mm->map_capacity = capacity;
+  }
+
+  memmove(mm->mmap + i + 1, mm->mmap + i, 
+          (mm->map_count - i) * sizeof *mm->mmap);
+  mm->mmap[i] = vm;
+  mm->map_count++;
+
+  lock_release(&mm->mmap_lock_w);
+
+  return true;
+}
+
+/* Remove a segment from memory descriptor without freeing it */
+void mm_remove_vm_area(struct mm_struct *mm, struct vm_area_struct *vm)
+{
+  size_t i;
+
+  lock_acquire(&mm->mmap_lock_w);
+
+  i = mm_upper_bound(mm, vm->vm_start);
+  ASSERT(i > 0 && mm->mmap[i - 1] == vm);
+  --i;
+
+  memmove(mm->mmap + i, mm->mmap + i + 1, 
+          (mm->map_count - i - 1) * sizeof *mm->mmap);
+  mm->map_count--;
+
+  if (mm->mmap_cache == vm)
+    mm->mmap_cache = NULL;
+  if (mm->vma_stack == vm)
+    mm->vma_stack = NULL;
+  if (mm->vma_heap == vm)
+    mm->vma_heap = NULL;
+
+  lock_release(&mm->mmap_lock_w);
+}
+
+/* Move the end of a segment to END, which must be page-aligned and not
+ * below its start. Pages above a lowered end are left to the caller, see
+ * vm_release_range() */
+bool mm_resize_vm_area(struct mm_struct *mm, struct vm_area_struct *vm,
+                       uint8_t *end)
+{
+  size_t i;
+  bool success = true;
 
-    /* No overlapping regions */
-    if (vma_insert->vm_end > vm->vm_start)
+  ASSERT(pg_ofs(end) == 0 && end >= vm->vm_start);
+
+  lock_acquire(&mm->mmap_lock_w);
+
+  i = mm_upper_bound(mm, vm->vm_start);
+  ASSERT(i > 0 && mm->mmap[i - 1] == vm);
+
+  if (i < mm->map_count && end > mm->mmap[i]->vm_start)
+    success = false;
+  else
+    vm->vm_end = end;
+
+  lock_release(&mm->mmap_lock_w);
+
+  return success;
+}
+
+/* Copies the segments of SRC into DST, which must have its page directory
+ * set. Executable segments of DST read from EXEC. Pages are left to
+ * vm_cow_dup(); memory mapped files are not inherited. */
+bool mm_dup(struct mm_struct *dst, struct mm_struct *src, struct file *exec)
+{
+  size_t i;
+
+  for (i = 0; i < src->map_count; i++) {
+    struct vm_area_struct *from = src->mmap[i];
+    struct vm_area_struct *vma;
+
+    if (from->vm_flags & VM_MMAP)
+      continue;
+
+    vma = kmem_cache_alloc(vm_area_cachep);
+    if (vma == NULL)
       return false;
 
-    if (vma_insert->next != NULL)
-    {
-      if (vm->vm_end > vma_insert->next->vm_start)
-        return false;
-      else
-        vm->next = vma_insert->next;
+    vma->vm_start = from->vm_start;
+    vma->vm_end = from->vm_end;
+    vma->vm_flags = from->vm_flags;
+    vma->mmap_id = from->mmap_id;
+    vma->dirty = from->dirty;
+    vma->vm_ops = from->vm_ops;
+    vma->vm_file = (from->vm_flags & VM_EXECUTABLE) ? exec : from->vm_file;
+    vma->vm_file_ofs = from->vm_file_ofs;
+    vma->vm_file_read_bytes = from->vm_file_read_bytes;
+    vma->vm_file_zero_bytes = from->vm_file_zero_bytes;
+    vma->vm_shmem = NULL;
+
+    if (!mm_insert_vm_area(dst, vma)) {
+      kmem_cache_free(vm_area_cachep, vma);
+      return false;
     }
 
-    vma_insert->next = vm;
+    /* Shared anonymous memory stays shared with the child */
+    if (from->vm_shmem != NULL) {
+      vma->vm_shmem = from->vm_shmem;
+      vm_shmem_ref(vma->vm_shmem);
+    }
 
-    lock_release(&mm->mmap_lock_w);
+    if (src->vma_stack == from)
+      dst->vma_stack = vma;
+    if (src->vma_heap == from)
+      dst->vma_heap = vma;
   }
 
+  dst->brk = src->brk;
   return true;
 }
 
@@ -124,6 +295,17 @@ static bool evict_clock_vmp(struct frame_entry *f,
   struct hash_elem *e;
   size_t swap = 0;
 
+  /* Shared frames have no single owner; vm_share_evict() unmaps the page
+   * from every process and applies the policy itself */
+  if (f->share != NULL) {
+    if (!vm_share_evict(f->share, policy == policy_second_chance))
+      return false;
+
+    (*vmp_ptr)->pte = (uintptr_t) f->share->kpage;
+    (*vmp_ptr)->swap = 0;
+    return true;
+  }
+
   /* Quit if the frame should not be pulled */
   if (!policy(f, NULL))
     return false;
@@ -166,10 +348,40 @@ static bool evict_clock_vmp(struct frame_entry *f,
 
 extern struct lock fs_lock;
 
-/* Gives a usable frame. Evict a page if needed */
-void *vm_kpage(struct vm_page_struct **vmp_ptr)
+/* Writes out the page of F, just pulled from the frame table by
+   evict_clock_vmp(), from KPAGE to SWAP or to its file */
+static void write_back(struct frame_entry *f, void *kpage, size_t swap)
+{
+  if (f->share != NULL) {
+    /* Read-only code: nothing to write back */
+    vm_share_release(f->share);
+  } else if (swap != 0) {
+    /* To swap */
+    swap_write(swap, kpage);
+    swap_lock_release(swap);
+  } else if (f->flags & PG_MMAP) {
+    /* To file */
+    struct vm_area_struct *vma = f->vma;
+    size_t offset = ((uintptr_t) f->upage - (uintptr_t) vma->vm_start) + 
+                    vma->vm_file_ofs;
+
+    int32_t write_bytes = vma->vm_file_read_bytes - offset;
+
+    if (write_bytes > 0) {
+      write_bytes = (write_bytes > PGSIZE) ? PGSIZE : write_bytes;
+      lock_acquire(&fs_lock);
+      file_write_at(vma->vm_file, kpage, write_bytes, offset);
+      lock_release(&fs_lock);
+    }
+  }
+}
+
+/* Gives a usable frame, zeroed if FLAGS has PAL_ZERO. Evict a page if
+   needed */
+static void *get_kpage(struct vm_page_struct **vmp_ptr,
+                       enum palloc_flags flags)
 {
-  void *kpage = palloc_get_page(PAL_USER);
+  void *kpage = palloc_get_page(PAL_USER | flags);
   struct frame_entry f;
 
   if (kpage == NULL)
@@ -188,33 +400,342 @@ void *vm_kpage(struct vm_page_struct **vmp_ptr)
     }
 
     kpage = (void *) ((*vmp_ptr)->pte & PTE_ADDR);
+    TRACE(TRACE_PAGE_OUT, f.upage);
 
     /* Should have a usable frame now */
     ASSERT((uintptr_t) kpage != 0);
 
-    size_t swap = (*vmp_ptr)->swap;
-
     /* Eviction */
-    if (swap != 0) {
-      /* To swap */
-      swap_write(swap, kpage);
-      swap_lock_release(swap);
-    } else if (f.flags & PG_MMAP) {
-      /* To file */
-      struct vm_area_struct *vma = f.vma;
-      size_t offset = ((uintptr_t) f.upage - (uintptr_t) vma->vm_start) + 
-                      vma->vm_file_ofs;
-
-      int32_t write_bytes = vma->vm_file_read_bytes - offset;
-
-      if (write_bytes > 0) {
-        write_bytes = (write_bytes > PGSIZE) ? PGSIZE : write_bytes;
-        lock_acquire(&fs_lock);
-        file_write_at(vma->vm_file, kpage, write_bytes, offset);
-        lock_release(&fs_lock);
+    write_back(&f, kpage, (*vmp_ptr)->swap);
+
+    if (flags & PAL_ZERO)
+      memset(kpage, 0, PGSIZE);
+  }
+
+  return kpage;
+}
+
+/* Frames the kernel may take back: private pages of other processes
+ * that are written back to swap or dropped.  Shared and mapped pages
+ * are left alone, as writing them back takes locks that the caller of
+ * palloc_get_page() may hold, and so are pages of the current process,
+ * whose page table it may be in the middle of changing */
+static bool reclaim_vmp(struct frame_entry *f, void *aux)
+{
+  if (f->share != NULL || (f->flags & PG_MMAP) ||
+      f->pagedir == thread_current()->PAGEDIR)
+    return false;
+  return evict_clock_vmp(f, aux);
+}
+
+/* Takes back one frame lent to user pages for the kernel: evicts a page
+ * through the clock, as a page fault would, and frees its frame.
+ * Registered with palloc_set_reclaim().  Returns false if no frame could
+ * be freed without waiting */
+bool vm_reclaim_page(void)
+{
+  struct vm_page_struct *vmp;
+  struct frame_entry f;
+  void *kpage;
+
+  if (lock_held_by_current_thread(&reclaim_lock) ||
+      !lock_try_acquire(&reclaim_lock))
+    return false;
+
+  vmp = kmem_cache_alloc(vm_page_cachep);
+  if (vmp == NULL) {
+    lock_release(&reclaim_lock);
+    return false;
+  }
+
+  struct policy_vmp pv = { 
+    .policy = policy_second_chance, 
+    .vmp_ptr = &vmp 
+  };
+
+  if (!frame_try_pull(&f, reclaim_vmp, &pv)) {
+    pv.policy = policy_fifo;
+    if (!frame_try_pull(&f, reclaim_vmp, &pv)) {
+      kmem_cache_free(vm_page_cachep, vmp);
+      lock_release(&reclaim_lock);
+      return false;
+    }
+  }
+
+  /* VMP is now the evicted page's old shadow entry */
+  kpage = (void *) (vmp->pte & PTE_ADDR);
+  TRACE(TRACE_PAGE_OUT, f.upage);
+  write_back(&f, kpage, vmp->swap);
+  kmem_cache_free(vm_page_cachep, vmp);
+  palloc_free_page(kpage);
+
+  lock_release(&reclaim_lock);
+  return true;
+}
+
+/* Gives a usable frame. Evict a page if needed */
+void *vm_kpage(struct vm_page_struct **vmp_ptr)
+{
+  return get_kpage(vmp_ptr, 0);
+}
+
+/* Gives a zeroed frame, usually one zeroed ahead of time by the idle
+   thread. Evict a page if needed */
+void *vm_kpage_zero(struct vm_page_struct **vmp_ptr)
+{
+  return get_kpage(vmp_ptr, PAL_ZERO);
+}
+
+/* Returns the shadow page table entry of UPAGE in VMA, or NULL */
+struct vm_page_struct *vm_page_lookup(struct vm_area_struct *vma,
+                                      uint8_t *upage)
+{
+  struct vm_page_struct key;
+  struct hash_elem *e;
+
+  key.upage = upage;
+  e = hash_find(&vma->vm_page_table, &key.elem);
+  return e != NULL ? hash_entry(e, struct vm_page_struct, elem) : NULL;
+}
+
+/* Subroutine called by frame_remove_if() from vm_release_range() */
+static bool frame_in_interval(struct frame_entry *f, void *aux)
+{
+  struct vm_interval *v = aux;
+
+  return f->pagedir == v->pagedir &&
+         v->vm_start <= (uint8_t *) f->upage &&
+         (uint8_t *) f->upage < v->vm_end;
+}
+
+/* Drops the pages of VMA within [START, END), which must no longer be
+ * part of it: frames are freed, swap slots released and shared pages
+ * unmapped */
+void vm_release_range(struct vm_area_struct *vma, uint8_t *start,
+                      uint8_t *end)
+{
+  struct vm_interval v = 
+  { 
+    .pagedir = vma->pagedir, 
+    .vm_start = start, 
+    .vm_end = end 
+  };
+  uint8_t *upage;
+
+  vm_share_unmap_range(vma, start, end);
+  frame_remove_if(frame_in_interval, &v);
+
+  for (upage = start; upage < end; upage += PGSIZE) {
+    struct vm_page_struct *vmp = vm_page_lookup(vma, upage);
+    void *kpage = pagedir_get_page(vma->pagedir, upage);
+
+    if (kpage != NULL) {
+      pagedir_clear_page(vma->pagedir, upage);
+      palloc_free_page(kpage);
+    }
+
+    if (vmp != NULL) {
+      hash_delete(&vma->vm_page_table, &vmp->elem);
+      /* Wait for an eviction that is still writing the slot */
+      if (vmp->swap != 0) {
+        swap_lock_acquire(vmp->swap);
+        swap_free(vmp->swap);
+        swap_lock_release(vmp->swap);
       }
+      kmem_cache_free(vm_page_cachep, vmp);
     }
   }
+}
+/* Number of pages in the fault-around window, 0 to disable.
+   Set by kernel command-line option "-fa=N". */
+size_t vm_fault_around_pages = VM_FAULT_AROUND_DEFAULT;
 
-  return kpage;
-}
\ No newline at end of file
+/* Pages mapped by fault-around so far */
+static long long fault_around_cnt;
+
+/* Returns true if UPAGE of VMA has never been brought in, or was dropped
+   without going to swap, so that it can be read back from the file */
+static bool vm_page_from_file(struct vm_area_struct *vma, uint8_t *upage)
+{
+  struct vm_page_struct key;
+  struct hash_elem *e;
+  struct vm_page_struct *vmp;
+
+  if ((size_t) (upage - vma->vm_start) >= vma->vm_file_read_bytes)
+    return false;
+
+  if (pagedir_get_page(vma->pagedir, upage) != NULL)
+    return false;
+
+  key.upage = upage;
+  e = hash_find(&vma->vm_page_table, &key.elem);
+  if (e == NULL)
+    return true;
+
+  vmp = hash_entry(e, struct vm_page_struct, elem);
+  return !(vmp->pte & PTE_P) && vmp->swap == 0;
+}
+
+/* Maps the file pages of VMA surrounding UPAGE, which has just been
+ * brought in by a page fault, so that nearby accesses do not fault.
+ * Only free frames are used; nothing is evicted for the sake of a page
+ * that may never be touched.  All reads are done under one fs_lock.
+ * Returns the number of pages mapped. */
+size_t vm_fault_around(struct vm_area_struct *vma, uint8_t *upage)
+{
+  uint8_t *kpages[VM_FAULT_AROUND_MAX];
+  uint8_t *upages[VM_FAULT_AROUND_MAX];
+  size_t window = vm_fault_around_pages;
+  size_t cnt = 0;
+  size_t i;
+  uint8_t *start, *end, *page;
+
+  if (window <= 1 || vma->vm_file == NULL)
+    return 0;
+  if (window > VM_FAULT_AROUND_MAX)
+    window = VM_FAULT_AROUND_MAX;
+
+  /* Aligned window containing UPAGE, clipped to the segment */
+  start = upage - ((upage - vma->vm_start) / PGSIZE % window) * PGSIZE;
+  end = start + window * PGSIZE;
+  if (end > vma->vm_end)
+    end = vma->vm_end;
+
+  lock_acquire(&fs_lock);
+  for (page = start; page < end; page += PGSIZE) {
+    off_t page_ofs = page - vma->vm_start;
+    int read_bytes;
+    uint8_t *kpage;
+
+    if (page == upage || !vm_page_from_file(vma, page))
+      continue;
+
+    kpage = palloc_get_page(PAL_USER);
+    if (kpage == NULL)
+      break;
+
+    read_bytes = vma->vm_file_read_bytes - page_ofs;
+    read_bytes = (read_bytes > PGSIZE) ? PGSIZE : read_bytes;
+
+    if (file_read_at(vma->vm_file, kpage, read_bytes, 
+                     vma->vm_file_ofs + page_ofs) != read_bytes) {
+      palloc_free_page(kpage);
+      break;
+    }
+    memset(kpage + read_bytes, 0, PGSIZE - read_bytes);
+
+    kpages[cnt] = kpage;
+    upages[cnt] = page;
+    cnt++;
+  }
+  lock_release(&fs_lock);
+
+  /* Publish the pages */
+  for (i = 0; i < cnt; i++) {
+    struct frame_entry f;
+    struct vm_page_struct *vmp = kmem_cache_alloc(vm_page_cachep);
+    struct hash_elem *e;
+    bool writable = (vma->vm_flags & VM_WRITE) != 0;
+
+    if (vmp == NULL || 
+        !pagedir_set_page(vma->pagedir, upages[i], kpages[i], writable)) {
+      kmem_cache_free(vm_page_cachep, vmp);
+      palloc_free_page(kpages[i]);
+      continue;
+    }
+
+    vmp->upage = upages[i];
+    vmp->swap = 0;
+    vmp->pte = (uintptr_t) kpages[i] | PTE_P | PTE_U;
+    if (writable) vmp->pte |= PTE_W;
+
+    e = hash_replace(&vma->vm_page_table, &vmp->elem);
+    if (e != NULL)
+      kmem_cache_free(vm_page_cachep,
+                      hash_entry(e, struct vm_page_struct, elem));
+
+    frame_make(&f, vma, upages[i]);
+    frame_push(&f);
+
+    fault_around_cnt++;
+  }
+
+  return cnt;
+}
+
+/* PF handler subroutine for zero-fill segments: the stack, the heap and
+ * anonymous mappings. Pages of shared anonymous memory belong to the
+ * region rather than the segment and are handled by vm/share.c. */
+static int32_t vm_anon_absent(struct vm_area_struct *vma, 
+                              struct vm_fault *vmf)
+{
+  uint8_t *kpage;
+  uint8_t *upage_in = (uint8_t *) ((uint32_t) vmf->fault_addr & ~PGMASK);
+
+  struct frame_entry f;
+
+  if (vma->vm_shmem != NULL)
+    return vm_share_absent(vma, vmf);
+
+  /* Reading a page that was never written needs no frame */
+  if (!vmf->write && vm_zero_map(vma, upage_in))
+    return true;
+
+  struct vm_page_struct *vmp_in = kmem_cache_alloc(vm_page_cachep);
+
+  /* A page that is not in swap starts out as all zeroes */
+  struct vm_page_struct *vmp_old = vm_page_lookup(vma, upage_in);
+  bool zeroed = vmp_old == NULL || vmp_old->swap == 0;
+
+  /* Bring in a frame, possibly evicting a page */
+  kpage = zeroed ? vm_kpage_zero(&vmp_in) : vm_kpage(&vmp_in);
+
+  frame_make(&f, vma, upage_in);
+  vmp_in->upage = upage_in;
+  vmp_in->swap = 0;
+
+  vmp_in->pte = (uintptr_t) kpage | PTE_P | PTE_W | PTE_U;
+
+  /* Update shadow page table while retriving swap slot */
+  struct hash_elem *e = hash_replace(&vma->vm_page_table, &vmp_in->elem);
+
+  size_t swap_in = 0;
+
+  if (e != NULL) {
+    vmp_in = hash_entry(e, struct vm_page_struct, elem);
+    swap_in = vmp_in->swap;
+    kmem_cache_free(vm_page_cachep, vmp_in);
+  }
+
+  /* Pin the new frame for kerkel PF */
+  if (!vmf->user)
+    frame_entry_pin(&f);
+
+  if (swap_in != 0) {
+    /* Read from swap */
+    swap_lock_acquire(swap_in);
+    swap_read(swap_in, kpage);
+    swap_lock_release(swap_in);
+    swap_free(swap_in);
+  }
+  else if (!zeroed) {
+    /* Or fill with zeroes */
+    memset(kpage, 0, PGSIZE);
+  }
+
+  bool success = pagedir_get_page(vma->pagedir, upage_in) == NULL &&
+                 pagedir_set_page(vma->pagedir, upage_in, kpage, true);
+
+  frame_push(&f);
+
+  return success;
+}
+
+struct vm_operations_struct vm_anon_ops = { .absent = vm_anon_absent };
+
+/* Prints virtual memory statistics */
+void vm_print_stats(void)
+{
+  printf("VM: %lld pages mapped by fault-around\n", fault_around_cnt);
+  vm_share_print_stats();
+}
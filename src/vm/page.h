@@ -7,6 +7,7 @@
 #include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
 #include "vm/swap.h"
@@ -15,6 +16,7 @@
 struct mm_struct;
 struct vm_area_struct;
 struct vm_operations_struct;
+struct vm_shmem;
 
 /* Flags for memory area descriptor
  *
@@ -30,19 +32,31 @@ enum vm_flag_t
     VM_SHARED =         0x0010,     /* Shared by processes */
     
     VM_EXECUTABLE =     0x0100,     /* Maps an executable file. */
-    VM_MMAP =           0x0200      /* Memory mapped file */
+    VM_MMAP =           0x0200,     /* Memory mapped file */
+    VM_ANON =           0x0400      /* Anonymous memory from mmap_anon() */
 };
 
+/* Largest size of the stack segment */
+#define VM_STACK_MAX (8 * 1024 * 1024)
+
 #define VM_PROT_DEFAULT (VM_PROT_READ | VM_PROT_WRITE)
 #define VM_PROT_ALL (VM_PROT_READ | VM_PROT_WRITE)
 
-/* Memory descriptor */
+/* Memory descriptor
+ *
+ * Segments are kept in an array sorted by vm_start so that mm_find() is a
+ * binary search, with the last segment found cached in front of it. */
 struct mm_struct
 {
     uint32_t *pagedir;
-    struct vm_area_struct *mmap;        /* The first memory segment */
+    struct vm_area_struct **mmap;       /* Segments sorted by vm_start */
+    size_t map_count;                   /* Number of segments in mmap */
+    size_t map_capacity;                /* Number of slots in mmap */
+    struct vm_area_struct *mmap_cache;  /* Last segment hit by mm_find() */
     struct vm_area_struct *vma_stack;   /* The stack segment */
-    struct lock mmap_lock_w;            /* Lock for modifying list structure */
+    struct vm_area_struct *vma_heap;    /* The heap segment */
+    uint8_t *brk;                       /* End of the heap, see sbrk() */
+    struct lock mmap_lock_w;            /* Lock for modifying mmap array */
 };
 
 /* Shadow page table entry owned by memory area descriptor */
@@ -63,7 +77,6 @@ struct vm_area_struct
         
     uint8_t *vm_start;              /* Start and end addresses */
     uint8_t *vm_end;
-    struct vm_area_struct *next;    /* Next segment */
 
     uint32_t vm_flags;
 
@@ -78,6 +91,8 @@ struct vm_area_struct
     off_t vm_file_ofs;              /* File offset at vm_start */
     uint32_t vm_file_read_bytes;
     uint32_t vm_file_zero_bytes;
+
+    struct vm_shmem *vm_shmem;      /* Shared anonymous memory, or NULL */
 };
 
 /* Lightweight struct for a virtual memory segment */
@@ -96,6 +111,7 @@ struct vm_fault {
     off_t page_ofs;         /* Page offset in the memory segment */
     void *fault_addr;       /* Faulting address */
     bool user;              /* From user or kernel */
+    bool write;             /* Write or read access */
 };
 
 struct vm_operations_struct {
@@ -104,17 +120,52 @@ struct vm_operations_struct {
     int32_t (*absent)(struct vm_area_struct *vma, struct vm_fault *vmf);
 };
 
+/* PF handler for zero-fill segments: the stack, the heap and anonymous
+ * mappings */
+extern struct vm_operations_struct vm_anon_ops;
+
+/* Object caches for memory area descriptors and page descriptors */
+extern struct kmem_cache *vm_area_cachep;
+extern struct kmem_cache *vm_page_cachep;
+
+void vm_page_init (void);
+
 void mm_init (struct mm_struct *);
+void mm_destroy (struct mm_struct *);
 
 /* returns false if insertion failed */
 bool mm_insert_vm_area (struct mm_struct *, struct vm_area_struct *);
+void mm_remove_vm_area (struct mm_struct *, struct vm_area_struct *);
+
+/* returns false if the segment would overlap the next one */
+bool mm_resize_vm_area (struct mm_struct *, struct vm_area_struct *,
+                        uint8_t *end);
 
 struct vm_area_struct *mm_find (struct mm_struct *, uint8_t *);
 
+bool mm_dup (struct mm_struct *dst, struct mm_struct *src, struct file *exec);
+
 struct hash_elem *vm_insert_page(struct vm_area_struct *, 
                                  void *upage,
                                  void *kpage);
 
 void *vm_kpage(struct vm_page_struct **vmp_in_ptr);
+void *vm_kpage_zero(struct vm_page_struct **vmp_in_ptr);
+bool vm_reclaim_page(void);
+
+struct vm_page_struct *vm_page_lookup(struct vm_area_struct *,
+                                      uint8_t *upage);
+
+void vm_release_range(struct vm_area_struct *, uint8_t *start, uint8_t *end);
+
+/* Fault-around: pages mapped per file-backed page fault */
+#define VM_FAULT_AROUND_DEFAULT 8
+#define VM_FAULT_AROUND_MAX 32
+
+extern size_t vm_fault_around_pages;
+
+size_t vm_fault_around(struct vm_area_struct *, uint8_t *upage);
+
+void vm_print_stats(void);
 
 #endif /* vm/page.h */
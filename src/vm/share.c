@@ -0,0 +1,1067 @@
+#include "vm/share.h"
+
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* One process mapping a shared page */
+struct vm_share_map
+{
+    uint32_t *pagedir;              /* Page directory of the mapper */
+    uint8_t *upage;                 /* Where it is mapped */
+    struct vm_area_struct *vma;     /* Segment holding UPAGE */
+    bool pinned;                    /* Pinned by a system call */
+    size_t swap;                    /* Slot taken on copy-on-write eviction */
+    struct list_elem elem;
+};
+
+/* Caches for struct vm_share and struct vm_share_map */
+static struct kmem_cache *share_cache;
+static struct kmem_cache *share_map_cache;
+
+/* Shared pages indexed by (inode, shmem, offset, read_bytes) */
+static struct hash share_table;
+
+/* Copy-on-write pages indexed by kpage */
+static struct hash cow_table;
+
+/* A frame of zeros mapped read-only wherever a zero-fill page has only
+ * been read. It has no frame table entry and is never evicted. */
+static void *zero_page;
+
+/* Protects both tables and every vm_share in them, and the shadow page
+ * table entries of every page they map.
+ * Lock order: table_lock in vm/frame.c, then share_lock. */
+static struct lock share_lock;
+
+/* Statistics */
+static long long share_hits;        /* Faults served by an existing frame */
+static long long share_misses;      /* Faults that read a new frame */
+static long long cow_shared;        /* Pages shared by vm_cow_dup() */
+static long long cow_copied;        /* Write faults that copied a page */
+static long long cow_reused;        /* Write faults on the last reference */
+static long long zero_maps;         /* Read faults served by zero_page */
+static long long zero_faults;       /* Write faults on zero_page */
+
+extern struct lock fs_lock;
+
+static unsigned share_hash (const struct hash_elem *e, void *aux UNUSED) {
+  const struct vm_share *sp = hash_entry(e, struct vm_share, elem);
+  return hash_int((uintptr_t) sp->inode) ^
+         hash_int((uintptr_t) sp->shmem) ^
+         hash_int(sp->ofs) ^
+         hash_int(sp->read_bytes);
+}
+
+static bool share_less (const struct hash_elem *a_,
+                        const struct hash_elem *b_,
+                        void *aux UNUSED) {
+  const struct vm_share *a = hash_entry(a_, struct vm_share, elem);
+  const struct vm_share *b = hash_entry(b_, struct vm_share, elem);
+
+  if (a->inode != b->inode)
+    return (uintptr_t) a->inode < (uintptr_t) b->inode;
+  if (a->shmem != b->shmem)
+    return (uintptr_t) a->shmem < (uintptr_t) b->shmem;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+static unsigned cow_hash (const struct hash_elem *e, void *aux UNUSED) {
+  const struct vm_share *sp = hash_entry(e, struct vm_share, elem);
+  return hash_int((uintptr_t) sp->kpage);
+}
+
+static bool cow_less (const struct hash_elem *a_,
+                      const struct hash_elem *b_,
+                      void *aux UNUSED) {
+  const struct vm_share *a = hash_entry(a_, struct vm_share, elem);
+  const struct vm_share *b = hash_entry(b_, struct vm_share, elem);
+
+  return (uintptr_t) a->kpage < (uintptr_t) b->kpage;
+}
+
+void vm_share_init(void)
+{
+  hash_init(&share_table, share_hash, share_less, NULL);
+  hash_init(&cow_table, cow_hash, cow_less, NULL);
+  lock_init(&share_lock);
+  share_cache = kmem_cache_create("vm_share", sizeof (struct vm_share), NULL);
+  share_map_cache = kmem_cache_create("vm_share_map",
+                                      sizeof (struct vm_share_map), NULL);
+  zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+}
+
+/* Read-only pages of the executable and shared anonymous memory are
+ * shared */
+bool vm_share_eligible(const struct vm_area_struct *vma)
+{
+  if (vma->vm_shmem != NULL)
+    return true;
+  return (vma->vm_flags & VM_EXECUTABLE) &&
+         !(vma->vm_flags & VM_WRITE) &&
+         vma->vm_file != NULL;
+}
+
+/* Writable private segments other than mapped files are copied on write */
+static bool cow_eligible(const struct vm_area_struct *vma)
+{
+  return (vma->vm_flags & VM_WRITE) &&
+         !(vma->vm_flags & (VM_MMAP | VM_SHARED));
+}
+
+/* The table SP lives in */
+static struct hash *share_table_of(struct vm_share *sp)
+{
+  return sp->inode != NULL || sp->shmem != NULL ? &share_table : &cow_table;
+}
+
+/* Fills KEY for page PAGE_OFS of VMA */
+static void share_key(struct vm_share *key,
+                      struct vm_area_struct *vma,
+                      off_t page_ofs)
+{
+  if (vma->vm_shmem != NULL) {
+    key->inode = NULL;
+    key->shmem = vma->vm_shmem;
+    key->ofs = page_ofs;
+    key->read_bytes = 0;
+    return;
+  }
+
+  int read_bytes = vma->vm_file_read_bytes - page_ofs;
+  read_bytes = (read_bytes < 0) ? 0 : read_bytes;
+  read_bytes = (read_bytes > PGSIZE) ? PGSIZE : read_bytes;
+
+  key->inode = file_get_inode(vma->vm_file);
+  key->shmem = NULL;
+  key->ofs = vma->vm_file_ofs + page_ofs;
+  key->read_bytes = read_bytes;
+}
+
+/* Must hold share_lock */
+static struct vm_share *share_find(struct vm_share *key)
+{
+  struct hash_elem *e = hash_find(&share_table, &key->elem);
+  return e != NULL ? hash_entry(e, struct vm_share, elem) : NULL;
+}
+
+/* Must hold share_lock */
+static struct vm_share *cow_find(void *kpage)
+{
+  struct vm_share key;
+  struct hash_elem *e;
+
+  key.kpage = kpage;
+  e = hash_find(&cow_table, &key.elem);
+  return e != NULL ? hash_entry(e, struct vm_share, elem) : NULL;
+}
+
+/* Returns the mapping of SP at UPAGE of PAGEDIR, or NULL */
+static struct vm_share_map *share_find_map(struct vm_share *sp,
+                                           uint32_t *pagedir,
+                                           uint8_t *upage)
+{
+  struct list_elem *e;
+
+  for (e = list_begin(&sp->maps); e != list_end(&sp->maps);
+       e = list_next(e)) {
+    struct vm_share_map *m = list_entry(e, struct vm_share_map, elem);
+    if (m->pagedir == pagedir && m->upage == upage)
+      return m;
+  }
+  return NULL;
+}
+
+/* Returns the shadow page table entry of UPAGE in VMA, or NULL */
+static struct vm_page_struct *share_shadow(struct vm_area_struct *vma,
+                                           uint8_t *upage)
+{
+  struct vm_page_struct key;
+  struct hash_elem *e;
+
+  key.upage = upage;
+  e = hash_find(&vma->vm_page_table, &key.elem);
+  return e != NULL ? hash_entry(e, struct vm_page_struct, elem) : NULL;
+}
+
+/* Maps SP at M's address and records M. Shared anonymous memory is
+ * mapped writable if the segment is, anything else read-only. Must hold
+ * share_lock, so that the page cannot be evicted between the two steps. */
+static bool share_add_map(struct vm_share *sp,
+                          struct vm_share_map *m,
+                          struct vm_page_struct *vmp)
+{
+  bool writable = sp->shmem != NULL && (m->vma->vm_flags & VM_WRITE);
+  struct hash_elem *e;
+
+  if (pagedir_get_page(m->pagedir, m->upage) != NULL ||
+      !pagedir_set_page(m->pagedir, m->upage, sp->kpage, writable))
+    return false;
+
+  vmp->upage = m->upage;
+  vmp->swap = 0;
+  vmp->pte = (uintptr_t) sp->kpage | PTE_P | PTE_U;
+  if (writable)
+    vmp->pte |= PTE_W;
+
+  /* Update shadow page table */
+  e = hash_replace(&m->vma->vm_page_table, &vmp->elem);
+  if (e != NULL)
+    kmem_cache_free(vm_page_cachep,
+                    hash_entry(e, struct vm_page_struct, elem));
+
+  m->swap = 0;
+  list_push_back(&sp->maps, &m->elem);
+  if (m->pinned)
+    sp->pin_cnt++;
+
+  return true;
+}
+
+/* PF handler subroutine for shareable code segments and shared anonymous
+ * memory */
+int32_t vm_share_absent(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+  uint8_t *upage = (uint8_t *) ((uint32_t) vmf->fault_addr & ~PGMASK);
+  struct vm_shmem *shmem = vma->vm_shmem;
+  struct vm_share key;
+  struct vm_share *sp;
+  struct vm_share_map *m = kmem_cache_alloc(share_map_cache);
+  struct vm_page_struct *vmp = kmem_cache_alloc(vm_page_cachep);
+  struct frame_entry f;
+  uint8_t *kpage;
+  size_t swap = 0;
+  bool success;
+
+  if (m == NULL || vmp == NULL) {
+    kmem_cache_free(share_map_cache, m);
+    kmem_cache_free(vm_page_cachep, vmp);
+    return false;
+  }
+
+  share_key(&key, vma, vmf->page_ofs);
+
+  m->pagedir = vma->pagedir;
+  m->upage = upage;
+  m->vma = vma;
+  m->pinned = !vmf->user;
+
+  /* A page of anonymous memory has only one copy, in memory or in swap:
+   * bring it in once */
+  if (shmem != NULL)
+    lock_acquire(&shmem->lock);
+
+  /* Another process may have the page already */
+  lock_acquire(&share_lock);
+  sp = share_find(&key);
+  if (sp != NULL) {
+    success = share_add_map(sp, m, vmp);
+    share_hits++;
+    lock_release(&share_lock);
+    goto done;
+  }
+  if (shmem != NULL)
+    swap = shmem->swap[key.ofs / PGSIZE];
+  lock_release(&share_lock);
+
+  /* Bring in a frame, possibly evicting a page */
+  if (shmem != NULL) {
+    kpage = swap == 0 ? vm_kpage_zero(&vmp) : vm_kpage(&vmp);
+    if (swap != 0) {
+      /* Wait for an eviction that is still writing the slot */
+      swap_lock_acquire(swap);
+      swap_read(swap, kpage);
+      swap_lock_release(swap);
+    }
+  } else {
+    kpage = vm_kpage(&vmp);
+
+    if (key.read_bytes > 0) {
+      lock_acquire(&fs_lock);
+      file_read_at(vma->vm_file, kpage, key.read_bytes, key.ofs);
+      lock_release(&fs_lock);
+    }
+    memset(kpage + key.read_bytes, 0, PGSIZE - key.read_bytes);
+  }
+
+  lock_acquire(&share_lock);
+  sp = share_find(&key);
+  if (sp != NULL) {
+    /* Lost the race to another process reading the same page */
+    success = share_add_map(sp, m, vmp);
+    share_hits++;
+    lock_release(&share_lock);
+    palloc_free_page(kpage);
+    goto done;
+  }
+
+  sp = kmem_cache_alloc(share_cache);
+  if (sp == NULL) {
+    lock_release(&share_lock);
+    palloc_free_page(kpage);
+    success = false;
+    goto done;
+  }
+
+  sp->inode = key.inode != NULL ? inode_reopen(key.inode) : NULL;
+  sp->shmem = key.shmem;
+  sp->ofs = key.ofs;
+  sp->read_bytes = key.read_bytes;
+  sp->kpage = kpage;
+  sp->pin_cnt = 0;
+  sp->swap = 0;
+  list_init(&sp->maps);
+  hash_insert(&share_table, &sp->elem);
+  if (shmem != NULL)
+    shmem->ref_cnt++;
+
+  success = share_add_map(sp, m, vmp);
+  share_misses++;
+  if (!success) {
+    hash_delete(&share_table, &sp->elem);
+    lock_release(&share_lock);
+    palloc_free_page(kpage);
+    vm_share_release(sp);
+    goto done;
+  }
+
+  /* The page is in memory now, the slot is no longer needed */
+  if (shmem != NULL)
+    shmem->swap[key.ofs / PGSIZE] = 0;
+  lock_release(&share_lock);
+
+  if (swap != 0)
+    swap_free(swap);
+
+  /* The frame stays in the table while any process maps it; our own
+   * mapping cannot go away before this process exits. */
+  memset(&f, 0, sizeof f);
+  f.share = sp;
+  f.flags = (shmem != NULL ? PG_DATA : PG_CODE) | PG_SHARED;
+  frame_push(&f);
+
+done:
+  if (shmem != NULL)
+    lock_release(&shmem->lock);
+  if (!success) {
+    kmem_cache_free(share_map_cache, m);
+    kmem_cache_free(vm_page_cachep, vmp);
+  }
+  return success;
+}
+
+/* Gives the page of anonymous memory SP a swap slot of its region, to be
+ * written by vm_share_release(). Must hold share_lock. */
+static void shmem_save(struct vm_share *sp)
+{
+  sp->swap = swap_get();
+  swap_lock_acquire(sp->swap);
+  sp->shmem->swap[sp->ofs / PGSIZE] = sp->swap;
+}
+
+/* Subroutine called by frame_remove_if() to drop frames that nobody maps
+ * any more */
+static bool frame_share_dead(struct frame_entry *f, void *aux UNUSED) {
+  bool dead;
+
+  if (f->share == NULL)
+    return false;
+
+  lock_acquire(&share_lock);
+  dead = list_empty(&f->share->maps);
+  lock_release(&share_lock);
+
+  return dead;
+}
+
+/* Frees the records on DEAD, whose mappings are all gone */
+static void share_free_dead(struct list *dead)
+{
+  if (list_empty(dead))
+    return;
+
+  frame_remove_if(frame_share_dead, NULL);
+
+  while (!list_empty(dead)) {
+    struct vm_share *sp =
+      list_entry(list_pop_front(dead), struct vm_share, dead_elem);
+
+    palloc_free_page(sp->kpage);
+    vm_share_release(sp);
+  }
+}
+
+/* Unmaps every shared page of VMA from its process. Frames that are no
+ * longer mapped by anybody are freed. */
+void vm_share_unmap_vma(struct vm_area_struct *vma)
+{
+  vm_share_unmap_range(vma, vma->vm_start, vma->vm_end);
+}
+
+/* Unmaps the shared pages of VMA within [START, END) from its process */
+void vm_share_unmap_range(struct vm_area_struct *vma, uint8_t *start,
+                          uint8_t *end)
+{
+  bool shared = vm_share_eligible(vma);
+  struct list dead;
+  uint8_t *upage;
+
+  if (!shared && !cow_eligible(vma))
+    return;
+
+  list_init(&dead);
+
+  lock_acquire(&share_lock);
+  for (upage = start; upage < end; upage += PGSIZE) {
+    void *kpage = pagedir_get_page(vma->pagedir, upage);
+    struct vm_share *sp;
+    struct vm_share_map *m;
+
+    if (kpage == NULL)
+      continue;
+
+    /* Keep pagedir_destroy() away from the zero page, too */
+    if (kpage == zero_page) {
+      pagedir_clear_page(vma->pagedir, upage);
+      continue;
+    }
+
+    if (shared) {
+      struct vm_share key;
+      share_key(&key, vma, upage - vma->vm_start);
+      sp = share_find(&key);
+    } else {
+      sp = cow_find(kpage);
+    }
+
+    /* Private page */
+    if (sp == NULL || (m = share_find_map(sp, vma->pagedir, upage)) == NULL)
+      continue;
+
+    list_remove(&m->elem);
+    if (m->pinned)
+      sp->pin_cnt--;
+    kmem_cache_free(share_map_cache, m);
+
+    /* Keep pagedir_destroy() away from the shared frame */
+    pagedir_clear_page(vma->pagedir, upage);
+
+    if (list_empty(&sp->maps)) {
+      hash_delete(share_table_of(sp), &sp->elem);
+      /* Keep anonymous memory that another segment may still map. The
+       * references left are this segment's and the page's own. */
+      if (sp->shmem != NULL && sp->shmem->ref_cnt > 2)
+        shmem_save(sp);
+      list_push_back(&dead, &sp->dead_elem);
+    }
+  }
+  lock_release(&share_lock);
+
+  share_free_dead(&dead);
+}
+
+/* Pins the mappings of SP by PAGEDIR within [START, END) */
+void vm_share_pin(struct vm_share *sp, uint32_t *pagedir,
+                  uint8_t *start, uint8_t *end)
+{
+  struct list_elem *e;
+
+  lock_acquire(&share_lock);
+  for (e = list_begin(&sp->maps); e != list_end(&sp->maps);
+       e = list_next(e)) {
+    struct vm_share_map *m = list_entry(e, struct vm_share_map, elem);
+    if (m->pagedir == pagedir && !m->pinned &&
+        start <= m->upage && m->upage < end) {
+      m->pinned = true;
+      sp->pin_cnt++;
+    }
+  }
+  lock_release(&share_lock);
+}
+
+/* Unpins the mappings of SP by PAGEDIR */
+void vm_share_unpin(struct vm_share *sp, uint32_t *pagedir)
+{
+  struct list_elem *e;
+
+  lock_acquire(&share_lock);
+  for (e = list_begin(&sp->maps); e != list_end(&sp->maps);
+       e = list_next(e)) {
+    struct vm_share_map *m = list_entry(e, struct vm_share_map, elem);
+    if (m->pagedir == pagedir && m->pinned) {
+      m->pinned = false;
+      sp->pin_cnt--;
+    }
+  }
+  lock_release(&share_lock);
+}
+
+/* Called by the clock algorithm with the frame table locked. Unmaps SP
+ * from every process and returns true, unless some mapping is pinned,
+ * or, if SECOND_CHANCE, has been accessed recently. Each process mapping
+ * a copy-on-write page gets a swap slot of its own; a page of anonymous
+ * memory gets one slot in its region. The caller owns the frame
+ * afterwards and must call vm_share_release(). */
+bool vm_share_evict(struct vm_share *sp, bool second_chance)
+{
+  struct list_elem *e;
+
+  lock_acquire(&share_lock);
+
+  /* Being freed by share_free_dead() */
+  if (list_empty(&sp->maps) || sp->pin_cnt > 0) {
+    lock_release(&share_lock);
+    return false;
+  }
+
+  if (second_chance) {
+    for (e = list_begin(&sp->maps); e != list_end(&sp->maps);
+         e = list_next(e)) {
+      struct vm_share_map *m = list_entry(e, struct vm_share_map, elem);
+      if (pagedir_is_accessed(m->pagedir, m->upage)) {
+        lock_release(&share_lock);
+        return false;
+      }
+    }
+  }
+
+  e = list_begin(&sp->maps);
+  while (e != list_end(&sp->maps)) {
+    struct vm_share_map *m = list_entry(e, struct vm_share_map, elem);
+    struct vm_page_struct *vmp = share_shadow(m->vma, m->upage);
+
+    pagedir_clear_page(m->pagedir, m->upage);
+
+    if (sp->inode != NULL || sp->shmem != NULL) {
+      /* Page can be read back from the file or the region */
+      if (vmp != NULL) {
+        vmp->pte = 0;
+        vmp->swap = 0;
+      }
+      e = list_remove(e);
+      kmem_cache_free(share_map_cache, m);
+    } else {
+      /* Written out by vm_share_release() */
+      ASSERT(vmp != NULL);
+      m->swap = swap_get();
+      swap_lock_acquire(m->swap);
+      vmp->pte = 0;
+      vmp->swap = m->swap;
+      e = list_next(e);
+    }
+  }
+
+  if (sp->shmem != NULL)
+    shmem_save(sp);
+  hash_delete(share_table_of(sp), &sp->elem);
+
+  lock_release(&share_lock);
+  return true;
+}
+
+/* Frees SP once it is out of its table and the frame table. Mappings left
+ * by vm_share_evict() have the page written to their swap slots first, and
+ * so does anonymous memory given a slot by shmem_save(). */
+void vm_share_release(struct vm_share *sp)
+{
+  while (!list_empty(&sp->maps)) {
+    struct vm_share_map *m =
+      list_entry(list_pop_front(&sp->maps), struct vm_share_map, elem);
+
+    swap_write(m->swap, sp->kpage);
+    swap_lock_release(m->swap);
+    kmem_cache_free(share_map_cache, m);
+  }
+
+  if (sp->swap != 0) {
+    swap_write(sp->swap, sp->kpage);
+    swap_lock_release(sp->swap);
+  }
+  if (sp->shmem != NULL)
+    vm_shmem_unref(sp->shmem);
+
+  if (sp->inode != NULL) {
+    lock_acquire(&fs_lock);
+    inode_close(sp->inode);
+    lock_release(&fs_lock);
+  }
+  kmem_cache_free(share_cache, sp);
+}
+
+/* Creates a region of PAGE_CNT pages of shared anonymous memory, all
+ * zeroes, with one reference. Returns NULL if out of memory. */
+struct vm_shmem *vm_shmem_create(size_t page_cnt)
+{
+  struct vm_shmem *shmem = malloc(sizeof *shmem);
+
+  if (shmem == NULL)
+    return NULL;
+
+  shmem->swap = calloc(page_cnt, sizeof *shmem->swap);
+  if (shmem->swap == NULL) {
+    free(shmem);
+    return NULL;
+  }
+
+  shmem->ref_cnt = 1;
+  shmem->page_cnt = page_cnt;
+  lock_init(&shmem->lock);
+  return shmem;
+}
+
+/* Takes a reference to SHMEM */
+void vm_shmem_ref(struct vm_shmem *shmem)
+{
+  lock_acquire(&share_lock);
+  shmem->ref_cnt++;
+  lock_release(&share_lock);
+}
+
+/* Drops a reference to SHMEM, freeing it and its swap slots with the last
+ * one */
+void vm_shmem_unref(struct vm_shmem *shmem)
+{
+  bool last;
+  size_t i;
+
+  lock_acquire(&share_lock);
+  last = --shmem->ref_cnt == 0;
+  lock_release(&share_lock);
+
+  if (!last)
+    return;
+
+  for (i = 0; i < shmem->page_cnt; i++)
+    if (shmem->swap[i] != 0)
+      swap_free(shmem->swap[i]);
+  free(shmem->swap);
+  free(shmem);
+}
+
+/* Data passed to cow_dup_func() */
+struct cow_dup
+{
+  uint32_t *pagedir;                /* Page directory being copied */
+  struct mm_struct *mm;             /* The copy */
+  bool success;
+};
+
+/* A swap slot to be copied by vm_cow_dup() */
+struct cow_copy
+{
+  size_t from;
+  size_t to;
+  struct list_elem elem;
+};
+
+/* Makes the mapping M read-only until the next write fault */
+static void cow_protect(struct vm_share_map *m)
+{
+  struct vm_page_struct *vmp = share_shadow(m->vma, m->upage);
+
+  pagedir_set_writable(m->pagedir, m->upage, false);
+  if (vmp != NULL)
+    vmp->pte &= ~PTE_W;
+}
+
+/* Maps SP in D->mm wherever D->pagedir maps it. Must hold share_lock. */
+static void cow_dup_shared(struct vm_share *sp, struct cow_dup *d)
+{
+  struct vm_share_map *pm = NULL;
+  struct vm_share_map *m;
+  struct vm_page_struct *vmp;
+  struct vm_area_struct *vma;
+  struct list_elem *e;
+
+  for (e = list_begin(&sp->maps); e != list_end(&sp->maps);
+       e = list_next(e)) {
+    struct vm_share_map *iter = list_entry(e, struct vm_share_map, elem);
+    if (iter->pagedir == d->pagedir) {
+      pm = iter;
+      break;
+    }
+  }
+
+  if (pm == NULL || (vma = mm_find(d->mm, pm->upage)) == NULL)
+    return;
+
+  m = kmem_cache_alloc(share_map_cache);
+  vmp = kmem_cache_alloc(vm_page_cachep);
+  if (m == NULL || vmp == NULL)
+    goto fail;
+
+  m->pagedir = d->mm->pagedir;
+  m->upage = pm->upage;
+  m->vma = vma;
+  m->pinned = false;
+
+  if (!share_add_map(sp, m, vmp))
+    goto fail;
+
+  if (sp->inode == NULL && sp->shmem == NULL)
+    cow_protect(pm);
+  cow_shared++;
+  return;
+
+fail:
+  kmem_cache_free(share_map_cache, m);
+  kmem_cache_free(vm_page_cachep, vmp);
+  d->success = false;
+}
+
+/* Turns the private frame F of D->pagedir into a copy-on-write page
+ * mapped by D->mm as well. Must hold share_lock. */
+static void cow_dup_private(struct frame_entry *f, struct cow_dup *d)
+{
+  struct vm_area_struct *vma = mm_find(d->mm, f->upage);
+  struct vm_share *sp;
+  struct vm_share_map *pm, *m;
+  struct vm_page_struct *vmp;
+  void *kpage = pagedir_get_page(d->pagedir, f->upage);
+
+  if (vma == NULL || kpage == NULL)
+    return;
+
+  sp = kmem_cache_alloc(share_cache);
+  pm = kmem_cache_alloc(share_map_cache);
+  m = kmem_cache_alloc(share_map_cache);
+  vmp = kmem_cache_alloc(vm_page_cachep);
+  if (sp == NULL || pm == NULL || m == NULL || vmp == NULL) {
+    kmem_cache_free(share_cache, sp);
+    kmem_cache_free(share_map_cache, pm);
+    kmem_cache_free(share_map_cache, m);
+    kmem_cache_free(vm_page_cachep, vmp);
+    d->success = false;
+    return;
+  }
+
+  sp->inode = NULL;
+  sp->shmem = NULL;
+  sp->ofs = 0;
+  sp->read_bytes = 0;
+  sp->kpage = kpage;
+  sp->pin_cnt = 0;
+  sp->swap = 0;
+  list_init(&sp->maps);
+  hash_insert(&cow_table, &sp->elem);
+
+  pm->pagedir = d->pagedir;
+  pm->upage = f->upage;
+  pm->vma = f->vma;
+  pm->pinned = (f->flags & PG_LOCKED) != 0;
+  pm->swap = 0;
+  list_push_back(&sp->maps, &pm->elem);
+  if (pm->pinned)
+    sp->pin_cnt++;
+  cow_protect(pm);
+
+  /* The frame table entry now stands for the shared page */
+  f->share = sp;
+  f->pagedir = NULL;
+  f->upage = NULL;
+  f->vma = NULL;
+  f->flags = (f->flags & (PG_CODE | PG_DATA)) | PG_SHARED;
+
+  m->pagedir = d->mm->pagedir;
+  m->upage = pm->upage;
+  m->vma = vma;
+  m->pinned = false;
+
+  if (share_add_map(sp, m, vmp)) {
+    cow_shared++;
+  } else {
+    kmem_cache_free(share_map_cache, m);
+    kmem_cache_free(vm_page_cachep, vmp);
+    d->success = false;
+  }
+}
+
+/* Subroutine called by frame_for_each() from vm_cow_dup() */
+static bool cow_dup_func(struct frame_entry *f, void *aux) {
+  struct cow_dup *d = aux;
+
+  if (!d->success)
+    return true;
+
+  lock_acquire(&share_lock);
+  if (f->share != NULL)
+    cow_dup_shared(f->share, d);
+  else if (f->pagedir == d->pagedir && cow_eligible(f->vma))
+    cow_dup_private(f, d);
+  lock_release(&share_lock);
+
+  return true;
+}
+
+/* Fills DST, whose segments have been copied from SRC by mm_dup(), with
+ * the pages of SRC. Frames in memory are shared and write-protected in
+ * both; pages in swap are copied to slots of DST's own. SRC must not run
+ * meanwhile. Returns false if out of memory. */
+bool vm_cow_dup(struct mm_struct *dst, struct mm_struct *src)
+{
+  struct cow_dup d = { .pagedir = src->pagedir, .mm = dst, .success = true };
+  struct list copies;
+  uint8_t *buf;
+  size_t i;
+
+  /* Pages in memory */
+  frame_for_each(cow_dup_func, &d);
+  if (!d.success)
+    return false;
+
+  /* Pages in swap. Every frame of SRC's writable segments is shared now,
+   * so their shadow page tables only change under share_lock. */
+  list_init(&copies);
+
+  lock_acquire(&share_lock);
+  for (i = 0; i < src->map_count && d.success; i++) {
+    struct vm_area_struct *vma = src->mmap[i];
+    struct vm_area_struct *dvma;
+    struct hash_iterator it;
+
+    if (!cow_eligible(vma) || (dvma = mm_find(dst, vma->vm_start)) == NULL)
+      continue;
+
+    hash_first(&it, &vma->vm_page_table);
+    while (hash_next(&it)) {
+      struct vm_page_struct *vmp =
+        hash_entry(hash_cur(&it), struct vm_page_struct, elem);
+      struct vm_page_struct *dvmp;
+      struct cow_copy *c;
+
+      if (vmp->swap == 0 || share_shadow(dvma, vmp->upage) != NULL)
+        continue;
+
+      dvmp = kmem_cache_alloc(vm_page_cachep);
+      c = malloc(sizeof *c);
+      if (dvmp == NULL || c == NULL) {
+        kmem_cache_free(vm_page_cachep, dvmp);
+        free(c);
+        d.success = false;
+        break;
+      }
+
+      dvmp->upage = vmp->upage;
+      dvmp->pte = 0;
+      dvmp->swap = swap_get();
+      swap_lock_acquire(dvmp->swap);
+      hash_insert(&dvma->vm_page_table, &dvmp->elem);
+
+      c->from = vmp->swap;
+      c->to = dvmp->swap;
+      list_push_back(&copies, &c->elem);
+    }
+  }
+  lock_release(&share_lock);
+
+  buf = palloc_get_page(0);
+  if (buf == NULL)
+    d.success = false;
+
+  while (!list_empty(&copies)) {
+    struct cow_copy *c =
+      list_entry(list_pop_front(&copies), struct cow_copy, elem);
+
+    if (buf != NULL) {
+      swap_lock_acquire(c->from);
+      swap_read(c->from, buf);
+      swap_lock_release(c->from);
+      swap_write(c->to, buf);
+    }
+    swap_lock_release(c->to);
+    free(c);
+  }
+
+  palloc_free_page(buf);
+  return d.success;
+}
+
+/* Maps the zero page read-only at UPAGE of VMA, a zero-fill page that is
+ * being read. Returns false if the page has been swapped out, in which
+ * case it needs a frame of its own. */
+bool vm_zero_map(struct vm_area_struct *vma, uint8_t *upage)
+{
+  struct vm_page_struct *vmp = share_shadow(vma, upage);
+  struct hash_elem *e;
+
+  if (!cow_eligible(vma) || (vmp != NULL && vmp->swap != 0))
+    return false;
+
+  vmp = kmem_cache_alloc(vm_page_cachep);
+  if (vmp == NULL ||
+      pagedir_get_page(vma->pagedir, upage) != NULL ||
+      !pagedir_set_page(vma->pagedir, upage, zero_page, false)) {
+    kmem_cache_free(vm_page_cachep, vmp);
+    return false;
+  }
+
+  vmp->upage = upage;
+  vmp->pte = (uintptr_t) zero_page | PTE_P | PTE_U;
+  vmp->swap = 0;
+  e = hash_replace(&vma->vm_page_table, &vmp->elem);
+  if (e != NULL)
+    kmem_cache_free(vm_page_cachep,
+                    hash_entry(e, struct vm_page_struct, elem));
+
+  zero_maps++;
+  return true;
+}
+
+/* Replaces the zero page at UPAGE of VMA by a zeroed frame of its own */
+static bool zero_fault(struct vm_area_struct *vma, uint8_t *upage, bool user)
+{
+  struct vm_page_struct *vmp = kmem_cache_alloc(vm_page_cachep);
+  struct frame_entry f;
+  struct hash_elem *e;
+  uint8_t *kpage;
+
+  if (vmp == NULL)
+    return false;
+
+  /* Bring in a frame, possibly evicting a page */
+  kpage = vm_kpage_zero(&vmp);
+
+  pagedir_clear_page(vma->pagedir, upage);
+  pagedir_set_page(vma->pagedir, upage, kpage, true);
+
+  vmp->upage = upage;
+  vmp->pte = (uintptr_t) kpage | PTE_P | PTE_W | PTE_U;
+  vmp->swap = 0;
+  e = hash_replace(&vma->vm_page_table, &vmp->elem);
+  if (e != NULL)
+    kmem_cache_free(vm_page_cachep,
+                    hash_entry(e, struct vm_page_struct, elem));
+
+  frame_make(&f, vma, upage);
+  if (!user)
+    frame_entry_pin(&f);
+  frame_push(&f);
+
+  zero_faults++;
+  return true;
+}
+
+/* PF handler subroutine for writes to present, read-only pages of VMA.
+ * Gives the process a private copy of a copy-on-write page, or the page
+ * itself if nobody else maps it, or a frame in place of the zero page.
+ * Returns false if FAULT_ADDR is none of those. */
+bool vm_cow_fault(struct vm_area_struct *vma, void *fault_addr, bool user)
+{
+  uint8_t *upage = (uint8_t *) ((uint32_t) fault_addr & ~PGMASK);
+  uint32_t *pd = vma->pagedir;
+  struct vm_page_struct *vmp;
+  struct vm_share *sp;
+  struct vm_share_map *m;
+  struct frame_entry f;
+  struct hash_elem *e;
+  struct list dead;
+  uint8_t *kpage, *newpage;
+  bool pinned;
+
+  if (!cow_eligible(vma))
+    return false;
+
+  /* Only this process changes its zero page mappings */
+  if (pagedir_get_page(pd, upage) == zero_page)
+    return zero_fault(vma, upage, user);
+
+  lock_acquire(&share_lock);
+  kpage = pagedir_get_page(pd, upage);
+  sp = (kpage != NULL) ? cow_find(kpage) : NULL;
+  if (sp == NULL) {
+    lock_release(&share_lock);
+    /* Evicted meanwhile, the access faults again as not present */
+    return kpage == NULL;
+  }
+
+  if (list_front(&sp->maps) == list_back(&sp->maps)) {
+    /* Last reference: take the page over */
+    vmp = share_shadow(vma, upage);
+    pagedir_set_writable(pd, upage, true);
+    if (vmp != NULL)
+      vmp->pte |= PTE_W;
+    cow_reused++;
+    lock_release(&share_lock);
+    return true;
+  }
+  lock_release(&share_lock);
+
+  /* Bring in a frame for the copy, possibly evicting a page */
+  vmp = kmem_cache_alloc(vm_page_cachep);
+  if (vmp == NULL)
+    return false;
+  newpage = vm_kpage(&vmp);
+
+  lock_acquire(&share_lock);
+  kpage = pagedir_get_page(pd, upage);
+  sp = (kpage != NULL) ? cow_find(kpage) : NULL;
+  m = (sp != NULL) ? share_find_map(sp, pd, upage) : NULL;
+  if (m == NULL) {
+    /* Evicted while we were waiting for the frame: try again */
+    lock_release(&share_lock);
+    palloc_free_page(newpage);
+    kmem_cache_free(vm_page_cachep, vmp);
+    return true;
+  }
+
+  memcpy(newpage, kpage, PGSIZE);
+
+  pinned = m->pinned || !user;
+  list_remove(&m->elem);
+  if (m->pinned)
+    sp->pin_cnt--;
+  kmem_cache_free(share_map_cache, m);
+
+  pagedir_clear_page(pd, upage);
+  pagedir_set_page(pd, upage, newpage, true);
+
+  vmp->upage = upage;
+  vmp->pte = (uintptr_t) newpage | PTE_P | PTE_W | PTE_U;
+  vmp->swap = 0;
+  e = hash_replace(&vma->vm_page_table, &vmp->elem);
+  if (e != NULL)
+    kmem_cache_free(vm_page_cachep,
+                    hash_entry(e, struct vm_page_struct, elem));
+
+  list_init(&dead);
+  if (list_empty(&sp->maps)) {
+    hash_delete(&cow_table, &sp->elem);
+    list_push_back(&dead, &sp->dead_elem);
+  }
+  cow_copied++;
+  lock_release(&share_lock);
+
+  /* The copy differs from the file: keep it off the clean-drop path */
+  frame_make(&f, vma, upage);
+  f.flags |= PG_DIRTY;
+  if (pinned)
+    frame_entry_pin(&f);
+  frame_push(&f);
+
+  share_free_dead(&dead);
+  return true;
+}
+
+/* Prints shared page statistics */
+void vm_share_print_stats(void)
+{
+  printf("VM: %lld shared code page hits, %lld misses\n",
+         share_hits, share_misses);
+  printf("VM: %lld pages shared copy-on-write, %lld copied, %lld reused\n",
+         cow_shared, cow_copied, cow_reused);
+  printf("VM: %lld zero page mappings, %lld replaced on write\n",
+         zero_maps, zero_faults);
+}
@@ -0,0 +1,83 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <hash.h>
+#include <list.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct mm_struct;
+struct vm_area_struct;
+struct vm_fault;
+
+/* A page mapped by several processes from a single frame. The page occupies
+ * one frame table entry that carries PG_SHARED; the processes mapping it are
+ * kept in MAPS, so the length of MAPS is the reference count.
+ *
+ * Read-only executable pages are shared by every process that maps the same
+ * page of the same inode. Pages of shared anonymous memory are keyed by
+ * their region and offset in it instead. Copy-on-write pages left by
+ * vm_cow_dup() have a null INODE and SHMEM and are looked up by KPAGE. */
+struct vm_share
+{
+    struct inode *inode;        /* Backing inode (hash key), or NULL */
+    struct vm_shmem *shmem;     /* Anonymous region (hash key), or NULL */
+    off_t ofs;                  /* Offset of the page in either (key) */
+    uint32_t read_bytes;        /* Bytes read from the inode (key) */
+
+    void *kpage;                /* The shared frame (key if copy-on-write) */
+    struct list maps;           /* List of struct vm_share_map */
+    size_t pin_cnt;             /* Mappings pinned by a system call */
+    size_t swap;                /* Slot of SHMEM the page is written to */
+
+    struct hash_elem elem;
+    struct list_elem dead_elem; /* Element in a list of pages to free */
+};
+
+/* Shared anonymous memory from mmap_anon(MAP_SHARED), inherited by the
+ * children of the process that mapped it. Each segment mapping the region
+ * holds a reference, and so does each of its pages in memory. A page of
+ * the region is kept by its vm_share while in memory and in SWAP while
+ * evicted, so that it survives the process that wrote it. */
+struct vm_shmem
+{
+    size_t ref_cnt;             /* References, under the share lock */
+    size_t page_cnt;            /* Length in pages */
+    size_t *swap;               /* Swap slot of each page, or 0 */
+    struct lock lock;           /* Serializes page faults on the region */
+};
+
+void vm_share_init (void);
+
+bool vm_share_eligible (const struct vm_area_struct *);
+
+int32_t vm_share_absent (struct vm_area_struct *, struct vm_fault *);
+
+void vm_share_unmap_vma (struct vm_area_struct *);
+void vm_share_unmap_range (struct vm_area_struct *,
+                           uint8_t *start, uint8_t *end);
+
+void vm_share_pin (struct vm_share *, uint32_t *pagedir,
+                   uint8_t *start, uint8_t *end);
+void vm_share_unpin (struct vm_share *, uint32_t *pagedir);
+
+bool vm_share_evict (struct vm_share *, bool second_chance);
+void vm_share_release (struct vm_share *);
+
+/* Shared anonymous memory */
+struct vm_shmem *vm_shmem_create (size_t page_cnt);
+void vm_shmem_ref (struct vm_shmem *);
+void vm_shmem_unref (struct vm_shmem *);
+
+/* Zero page */
+bool vm_zero_map (struct vm_area_struct *, uint8_t *upage);
+
+/* Copy-on-write */
+bool vm_cow_dup (struct mm_struct *dst, struct mm_struct *src);
+bool vm_cow_fault (struct vm_area_struct *, void *fault_addr, bool user);
+
+void vm_share_print_stats (void);
+
+#endif /* vm/share.h */
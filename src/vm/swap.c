@@ -10,6 +10,7 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/interrupt.h"
+#include "threads/trace.h"
 
 static struct block *swap_block;        /* Point to swap disk */
 static size_t swap_size;                /* Number of slots */
@@ -118,6 +119,8 @@ void swap_read(size_t idx, void *kpage) {
     uint8_t *ptr = kpage;
     block_sector_t sector;
 
+    TRACE(TRACE_SWAP_READ, idx);
+
     for (sector = TO_SECTOR(idx); sector < TO_SECTOR(idx + 1); ++sector)
     {
         block_read(swap_block, sector, ptr);
@@ -131,6 +134,8 @@ void swap_write(size_t idx, const void *kpage) {
     const uint8_t *ptr = kpage;
     block_sector_t sector;
 
+    TRACE(TRACE_SWAP_WRITE, idx);
+
     for (sector = TO_SECTOR(idx); sector < TO_SECTOR(idx + 1); ++sector)
     {
         block_write(swap_block, sector, ptr);